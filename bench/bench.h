@@ -0,0 +1,20 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+// What the benchmarks share, main's in entities.cpp
+namespace Bench {
+
+// Small sizes are repeated until they've covered about this many entities, so timings settle
+size_t repeats(const size_t count);
+// Whether the benchmark called name passes the command line filter
+bool wanted(const std::string &name);
+void report(const std::string &name, const size_t count, const std::chrono::duration< double > seconds, const size_t reps);
+std::chrono::duration< double > timed(const std::function< void() > &work);
+
+}
+
+// Swarm steering, each kernel against the double precision reference
+void boids();
@@ -0,0 +1,156 @@
+// Swarm steering at flocking density, the flat float kernels against the per pair
+//      double precision steering they replaced, which is also what their error's measured from
+
+#include "bench.h"
+#include "game/boids.h"
+#include "game/spatial.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::vector< size_t > DRONE_COUNTS = { 1000, 10000, 50000 };
+const size_t SWARMS = 4;
+
+const Boids::Params PARAMS{ 40.0f, 10.0f, 10.0f, 4.0f, float((100 + 100) / 6.0) };
+
+struct Drones {
+    std::vector< Vec > at;
+    std::vector< Vec > velo;
+    std::vector< uint16_t > tag;
+};
+
+// Swarms bunch up, so each is a blob with a few dozen mates in reach of every drone
+Drones makeDrones(const size_t count) {
+    std::mt19937_64 gen(count);
+    const float spread = std::sqrt(float(count) / SWARMS) / 2.0f;
+    std::uniform_real_distribution< float > place(-100.0f, 100.0f);
+    std::uniform_real_distribution< float > speed(-10.0f, 10.0f);
+    std::vector< Vec > centres;
+    for (size_t s = 0; s < SWARMS; ++s) {
+        centres.emplace_back(place(gen), place(gen));
+    }
+    std::normal_distribution< float > blob(0.0f, spread);
+    Drones drones;
+    for (size_t i = 0; i < count; ++i) {
+        const uint16_t tag = i % SWARMS;
+        // Floats, like Box2D hands out
+        drones.at.emplace_back(float(centres[tag].x() + blob(gen)), float(centres[tag].y() + blob(gen)));
+        drones.velo.emplace_back(speed(gen), speed(gen));
+        drones.tag.push_back(tag);
+    }
+    return drones;
+}
+
+// How the swarm steered before, pairs found through the spatial index, in doubles
+void reference(const Drones &drones, SpatialIndex &index, std::vector< Vec > &out) {
+    const size_t n = drones.at.size();
+    struct Info { Vec centre{ 0.0, 0.0 }; Vec heading{ 0.0, 0.0 }; size_t count = 0; };
+    std::vector< Info > swarms(SWARMS);
+    for (size_t i = 0; i < n; ++i) {
+        auto &info = swarms[drones.tag[i]];
+        ++info.count;
+        info.centre += drones.at[i];
+        info.heading += normalized(drones.velo[i]);
+        index.insert(i, drones.at[i], SpatialIndex::NONE, drones.tag[i]);
+    }
+    for (auto &info : swarms) {
+        info.centre /= std::max(size_t(1), info.count);
+        info.heading = normalized(info.heading);
+    }
+    index.build();
+
+    const double reach = PARAMS.reach;
+    const double shy = reach * reach;
+    const double tether = PARAMS.tether;
+    out.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Info &info = swarms[drones.tag[i]];
+        const Vec at = drones.at[i];
+        Vec avoid{ 0.0, 0.0 };
+        SpatialIndex::Filter mates;
+        mates.tag = drones.tag[i];
+        index.within(at, reach, mates, [&](const SpatialIndex::Entry &mate) {
+            if (mate.id == i) { return; }
+            const Vec diff = mate.at - at;
+            if (diff.squared_length() < shy && diff.squared_length() > 0.0) {
+                avoid -= normalized(diff) * (shy - diff.squared_length()) / shy;
+            }
+        });
+        const Vec centre_diff = Vec(0.0, 0.0) - at;
+        const double centre_dist = centre_diff.squared_length();
+        const double pull = (centre_dist < tether * tether) ? 0.0 : centre_dist / tether;
+        out[i] = normalized(info.centre - at) * PARAMS.group
+               + info.heading * PARAMS.align
+               + normalized(avoid) * PARAMS.avoid
+               + normalized(centre_diff) * pull * 10.0;
+    }
+}
+
+void kernel(const Drones &drones, const Boids::Level level, Boids::Flock &flock, std::vector< Vec > &out) {
+    const size_t n = drones.at.size();
+    flock.clear();
+    for (size_t i = 0; i < n; ++i) {
+        flock.add(drones.at[i].x(), drones.at[i].y(), drones.velo[i].x(), drones.velo[i].y(), drones.tag[i]);
+    }
+    std::vector< Boids::Sum > sums(size_t(flock.highestTag()) + 1);
+    flock.sum(0, n, sums);
+    std::vector< Boids::Swarm > swarms;
+    Boids::finish(sums, swarms);
+    flock.prepare(PARAMS.reach);
+    std::vector< float > fx(n), fy(n);
+    flock.forces(swarms, PARAMS, level, 0, n, fx.data(), fy.data());
+    out.resize(n);
+    for (size_t s = 0; s < n; ++s) {
+        out[flock.added(s)] = Vec(fx[s], fy[s]);
+    }
+}
+
+// Worst difference from the reference, relative to the most the unit steering terms add up to
+// The pull back to the centre grows without bound, so it'd hide errors in the rest
+double error(const std::vector< Vec > &got, const std::vector< Vec > &want) {
+    double worst = 0.0;
+    for (size_t i = 0; i < want.size(); ++i) {
+        worst = std::max(worst, std::sqrt((got[i] - want[i]).squared_length()));
+    }
+    return worst / (PARAMS.avoid + PARAMS.align + PARAMS.group);
+}
+
+}
+
+void boids() {
+    using namespace Bench;
+    std::vector< Boids::Level > levels;
+    for (const Boids::Level level : { Boids::Level::Scalar, Boids::Level::SSE, Boids::Level::AVX2 }) {
+        if (level <= Boids::bestLevel()) { levels.push_back(level); }
+    }
+    for (const size_t count : DRONE_COUNTS) {
+        const Drones drones = makeDrones(count);
+        const size_t reps = std::max(size_t(1), repeats(count) / 20);
+        std::vector< Vec > want, got;
+        if (wanted("boids reference")) {
+            SpatialIndex index(PARAMS.reach);
+            const auto seconds = timed([&]() {
+                for (size_t rep = 0; rep < reps; ++rep) { reference(drones, index, want); }
+            });
+            report("boids reference", count, seconds, reps);
+        } else {
+            SpatialIndex index(PARAMS.reach);
+            reference(drones, index, want);
+        }
+        for (const Boids::Level level : levels) {
+            const std::string name = std::string("boids ") + Boids::levelName(level);
+            if (!wanted(name)) { continue; }
+            Boids::Flock flock;
+            const auto seconds = timed([&]() {
+                for (size_t rep = 0; rep < reps; ++rep) { kernel(drones, level, flock, got); }
+            });
+            report(name, count, seconds, reps);
+            std::cout << "    relative error " << std::scientific << error(got, want) << std::defaultfloat << '\n';
+        }
+    }
+}
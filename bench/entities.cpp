@@ -0,0 +1,271 @@
+// Microbenchmarks for the entity core, each reporting nanoseconds an entity
+// Usage: hallbench [filter], which only runs benchmarks with filter in their name
+
+#include "bench.h"
+#include "entities/tracker.h"
+#include "entities/exec.h"
+#include "entities/systems.h"
+#include "input/input.h"
+#include "visual/renderer.h"
+#include "core/core.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <string>
+#include <chrono>
+#include <vector>
+
+struct A { double x; };
+DeclareDataType(A);
+struct B { double x; };
+DeclareDataType(B);
+struct C { double x; };
+DeclareDataType(C);
+struct D { double x; };
+DeclareDataType(D);
+struct Tag { double x; };
+DeclareDataType(Tag);
+
+namespace Bench {
+
+namespace {
+
+const size_t ENTITIES_PER_CASE = 2000000;
+std::string filter;
+
+}
+
+size_t repeats(const size_t count) {
+    return std::max(size_t(1), ENTITIES_PER_CASE / count);
+}
+
+bool wanted(const std::string &name) {
+    return std::string::npos != name.find(filter);
+}
+
+void report(const std::string &name, const size_t count, const std::chrono::duration< double > seconds, const size_t reps) {
+    const double ns = seconds.count() * 1e9 / (double(count) * reps);
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << count
+              << std::setw(12) << std::fixed << std::setprecision(2) << ns << " ns/entity\n";
+}
+
+std::chrono::duration< double > timed(const std::function< void() > &work) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    work();
+    return std::chrono::high_resolution_clock::now() - start;
+}
+
+}
+
+using namespace Bench;
+
+namespace {
+
+const std::vector< size_t > CHURN_SIZES = { 1000, 10000, 100000 };
+const std::vector< size_t > ITERATION_SIZES = { 1000, 10000, 100000, 1000000 };
+
+AccumulateTimer entity_time;
+
+// A tracker with everything it needs to run, built fresh for each case
+struct World {
+    boost::program_options::variables_map options;
+    Input input;
+    Renderer renderer;
+    Entity::Tracker tracker;
+    Entity::SystemManager systems;
+    Core core;
+
+    static boost::program_options::variables_map &withDefaults(boost::program_options::variables_map &options) {
+        options.insert({ "j", boost::program_options::variable_value(size_t(0), false) });
+        options.insert({ "replan", boost::program_options::variable_value(size_t(0), false) });
+        return options;
+    }
+
+    World()
+        : renderer(16, 16)
+        , systems(withDefaults(options))
+        , core{ input, tracker, renderer, systems, { std::mutex(), std::make_unique< b2World >(b2Vec2(0, 0)) },
+                options, 128, Point(0.0, 0.0), Core::FlagMap() } {
+        tracker.addSource< AData >();
+        tracker.addSource< BData >();
+        tracker.addSource< CData >();
+        tracker.addSource< DData >();
+        tracker.addSource< TagData >();
+    }
+
+    std::vector< Entity::EntityID > populate(const size_t count) {
+        const auto ids = tracker.createMany< A, B, C, D >(core, count,
+            [](size_t i) { return A{ double(i) }; }, B{ 1.0 }, C{ 2.0 }, D{ 3.0 });
+        tracker.graduate();
+        return ids;
+    }
+};
+
+// Spawning and reaping, split into their stages
+void churn() {
+    if (!wanted("create") && !wanted("graduate") && !wanted("killEntity") && !wanted("finalizeKills")) { return; }
+    for (const size_t count : CHURN_SIZES) {
+        std::chrono::duration< double > create(0), graduate(0), kill(0), reap(0);
+        const size_t reps = repeats(count);
+        for (size_t rep = 0; rep < reps; ++rep) {
+            World world;
+            std::vector< Entity::EntityID > ids;
+            create += timed([&]() {
+                ids = world.tracker.createMany< A, B >(world.core, count, A{ 0.0 }, B{ 1.0 });
+            });
+            graduate += timed([&]() { world.tracker.graduate(); });
+            kill += timed([&]() {
+                for (const auto id : ids) {
+                    world.tracker.killEntity(world.core, id);
+                }
+            });
+            reap += timed([&]() { world.tracker.finalizeKills(world.core); });
+        }
+        if (wanted("create")) { report("create", count, create, reps); }
+        if (wanted("graduate")) { report("graduate", count, graduate, reps); }
+        if (wanted("killEntity")) { report("killEntity", count, kill, reps); }
+        if (wanted("finalizeKills")) { report("finalizeKills", count, reap, reps); }
+    }
+}
+
+// Moving every entity to another archetype and back
+void moves() {
+    if (!wanted("addComponent") && !wanted("removeComponent")) { return; }
+    for (const size_t count : CHURN_SIZES) {
+        std::chrono::duration< double > add(0), remove(0);
+        const size_t reps = repeats(count);
+        for (size_t rep = 0; rep < reps; ++rep) {
+            World world;
+            const auto ids = world.populate(count);
+            // Outside of systems the moves wait for finalizeKills, so that's part of their cost
+            add += timed([&]() {
+                for (const auto id : ids) {
+                    world.tracker.addComponent(world.core, id, Tag{ 0.0 });
+                }
+                world.tracker.finalizeKills(world.core);
+            });
+            remove += timed([&]() {
+                for (const auto id : ids) {
+                    world.tracker.removeComponent< Tag >(world.core, id);
+                }
+                world.tracker.finalizeKills(world.core);
+            });
+        }
+        if (wanted("addComponent")) { report("addComponent", count, add, reps); }
+        if (wanted("removeComponent")) { report("removeComponent", count, remove, reps); }
+    }
+}
+
+template< typename Query, typename Func >
+void iterate(const std::string &name, const Func &f) {
+    if (!wanted(name)) { return; }
+    for (const size_t count : ITERATION_SIZES) {
+        World world;
+        world.populate(count);
+        const size_t reps = repeats(count);
+        // Once first, so the query's cached and the rows are warm
+        Query::run(world.tracker, f);
+        const auto seconds = timed([&]() {
+            for (size_t rep = 0; rep < reps; ++rep) {
+                Query::run(world.tracker, f);
+            }
+        });
+        report(name, count, seconds, reps);
+    }
+}
+
+void iteration() {
+    iterate< Entity::ExecSimple< A > >("exec 1 component",
+    [](const auto &, auto &as) {
+        for (auto &a : as) { a.x += 1.0; }
+    });
+    iterate< Entity::ExecSimple< A, const B > >("exec 2 components",
+    [](const auto &, auto &as, const auto &bs) {
+        for (size_t i = 0; i < as.size(); ++i) { as[i].x += bs[i].x; }
+    });
+    iterate< Entity::ExecSimple< A, const B, const C > >("exec 3 components",
+    [](const auto &, auto &as, const auto &bs, const auto &cs) {
+        for (size_t i = 0; i < as.size(); ++i) { as[i].x += bs[i].x * cs[i].x; }
+    });
+    iterate< Entity::ExecSimple< A, const B, const C, const D > >("exec 4 components",
+    [](const auto &, auto &as, const auto &bs, const auto &cs, const auto &ds) {
+        for (size_t i = 0; i < as.size(); ++i) { as[i].x += bs[i].x * cs[i].x + ds[i].x; }
+    });
+}
+
+// Lookups by id in no particular order, like following a target
+void randomAccess() {
+    if (!wanted("optComponent")) { return; }
+    for (const size_t count : ITERATION_SIZES) {
+        World world;
+        auto ids = world.populate(count);
+        std::shuffle(ids.begin(), ids.end(), std::mt19937_64(count));
+        const size_t reps = repeats(count);
+        double sum = 0.0;
+        const auto seconds = timed([&]() {
+            for (size_t rep = 0; rep < reps; ++rep) {
+                for (const auto id : ids) {
+                    const auto a = world.tracker.optComponent< const A >(id);
+                    if (a) { sum += a->get().x; }
+                }
+            }
+        });
+        report("optComponent", count, seconds, reps);
+        // So the lookups aren't optimised away
+        if (sum < 0.0) { std::cout << sum << '\n'; }
+    }
+}
+
+// Each writes its own type, so all of them can run at once
+template< typename T >
+struct Bump: public Entity::BaseSystem {
+    using Rows = Entity::ExecSimple< T >;
+
+    Bump(): BaseSystem(str(Entity::DataTypeName< T >()), Entity::Queries< Rows >::access()) { }
+
+    void execute(Core &core, double) {
+        Rows::run(core.tracker, [](const auto &, auto &ts) {
+            for (auto &t : ts) { t.x += 1.0; }
+        });
+    }
+};
+
+// A whole tick of independent systems, scheduling and playback included
+void ticks() {
+    if (!wanted("systems tick")) { return; }
+    for (const size_t count : ITERATION_SIZES) {
+        World world;
+        world.systems.addSystem(std::make_unique< Bump< A > >());
+        world.systems.addSystem(std::make_unique< Bump< B > >());
+        world.systems.addSystem(std::make_unique< Bump< C > >());
+        world.systems.addSystem(std::make_unique< Bump< D > >());
+        world.systems.init(world.core);
+        world.populate(count);
+        const size_t reps = repeats(count);
+        world.systems.execute(world.core, 0.0);
+        const auto seconds = timed([&]() {
+            for (size_t rep = 0; rep < reps; ++rep) {
+                world.systems.execute(world.core, 0.0);
+            }
+        });
+        report("systems tick", count, seconds, reps);
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    Entity::k_entity_timer = &entity_time;
+    if (argc > 1) { Bench::filter = argv[1]; }
+    churn();
+    moves();
+    iteration();
+    randomAccess();
+    ticks();
+    boids();
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include "entities/access.h"
+#include "entities/systems.h"
+#include "utility/utility.h"
+
+namespace Entity {
+
+namespace {
+
+thread_local const BaseSystem *k_current_system = nullptr;
+
+}
+
+const BaseSystem *AccessScope::current() {
+    return k_current_system;
+}
+
+AccessScope::AccessScope(const BaseSystem *system): previous(k_current_system) {
+    k_current_system = system;
+}
+
+AccessScope::~AccessScope() {
+    k_current_system = previous;
+}
+
+void checkAccess(const ConstySignature &used, const char *what) {
+    const BaseSystem *system = k_current_system;
+    if (!system) { return; }
+    Signature readable = system->signature.reads;
+    readable |= system->signature.writes;
+    rassert(system->signature.writes.includes(used.writes) && readable.includes(used.reads),
+            "System touched components it didn't declare",
+            system->name, what, signatureString(used), signatureString(system->signature));
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "entities/signature.h"
+
+namespace Entity {
+
+class BaseSystem;
+
+// Components a system reaches by id instead of through a query, like with optComponent
+template< typename ...Types >
+struct Lookup {
+    static ConstySignature access() {
+        return getConstySignature< Types... >();
+    }
+};
+
+// Everything a system's queries and lookups touch, which is what it's scheduled by
+// Each of Types is an Exec, ExecSimple or Lookup
+template< typename ...Types >
+struct Queries {
+    static ConstySignature access() {
+        ConstySignature sig;
+        (..., (sig |= Types::access()));
+        return sig;
+    }
+};
+
+// Makes a system the one the calling thread's accesses are checked against until the scope ends
+class AccessScope {
+    const BaseSystem *previous;
+    public:
+        // The calling thread's system, if it's running one
+        static const BaseSystem *current();
+
+        AccessScope(const BaseSystem *system);
+        ~AccessScope();
+};
+
+// Asserts the calling thread's system declared everything in used
+// Outside of systems anything goes
+void checkAccess(const ConstySignature &used, const char *what);
+
+}
+
+#ifdef CHECK_ACCESS
+#define CHECK_ACCESS_TO(used, what) ::Entity::checkAccess(used, what)
+#else
+#define CHECK_ACCESS_TO(used, what)
+#endif
@@ -0,0 +1,240 @@
+#include "entities/archetype.h"
+
+#include "utility/utility.h"
+
+#include <algorithm>
+
+namespace Entity {
+
+Archetype::Archetype(const Signature &sig, const bool nursery, const Sources &sources)
+    : signature(sig)
+    , nursery(nursery)
+    , sources(sources)
+    , types(sig.begin(), sig.end())
+    , rows(0) {
+    size_t rowBytes = sizeof(EntityID);
+    for (const TypeID tid : types) {
+        const auto loc = sources.find(tid);
+        rassert(sources.end() != loc, "Missing type used!", tid, sig);
+        rowBytes += loc->second->rowSize();
+    }
+    // types is in signature order, so columns follow the set bits
+    size_t col = 0;
+    for (auto it = sig.begin(); it != sig.end(); ++it, ++col) {
+        if (it.typeIndex() >= columns.size()) { columns.resize(it.typeIndex() + 1, npos); }
+        columns[it.typeIndex()] = col;
+        typeIndices.push_back(it.typeIndex());
+    }
+    capacity = std::max(size_t(1), CHUNK_BYTES / rowBytes);
+}
+
+const OrderedSignature &Archetype::getTypes() const {
+    return types;
+}
+
+const std::vector< size_t > &Archetype::getTypeIndices() const {
+    return typeIndices;
+}
+
+size_t Archetype::column(const size_t typeIndex) const {
+    return (typeIndex < columns.size()) ? columns[typeIndex] : npos;
+}
+
+size_t Archetype::count() const {
+    return rows;
+}
+
+size_t Archetype::chunkCapacity() const {
+    return capacity;
+}
+
+Chunk &Archetype::openChunk() {
+    if (chunks.empty() || chunks.back()->size() >= capacity) {
+        auto chunk = std::make_unique< Chunk >();
+        chunk->index = chunks.size();
+        chunk->ids.reserve(capacity);
+        chunk->columns.reserve(types.size());
+        for (const TypeID tid : types) {
+            chunk->columns.push_back(sources.at(tid)->makeColumn(capacity));
+        }
+        chunks.push_back(std::move(chunk));
+    }
+    return *chunks.back();
+}
+
+Location Archetype::append(const EntityID id) {
+    Chunk &chunk = openChunk();
+    chunk.ids.push_back(id);
+    for (auto &col : chunk.columns) {
+        col->addDefault();
+    }
+    ++rows;
+    return Location{ this, &chunk, chunk.size() - 1 };
+}
+
+void Archetype::appendMany(const std::vector< EntityID > &ids, std::vector< Location > &out) {
+    size_t done = 0;
+    while (done < ids.size()) {
+        Chunk &chunk = openChunk();
+        const size_t start = chunk.size();
+        const size_t take = std::min(capacity - start, ids.size() - done);
+        chunk.ids.insert(chunk.ids.end(), ids.begin() + done, ids.begin() + done + take);
+        for (auto &col : chunk.columns) {
+            col->addDefaults(take);
+        }
+        for (size_t i = 0; i < take; ++i) {
+            out.push_back(Location{ this, &chunk, start + i });
+        }
+        done += take;
+        rows += take;
+    }
+}
+
+Location Archetype::adopt(Archetype &other, Chunk &from, const size_t row) {
+    Chunk &chunk = openChunk();
+    chunk.ids.push_back(from.ids[row]);
+    for (size_t i = 0; i < types.size(); ++i) {
+        const size_t theirs = other.column(typeIndices[i]);
+        if (npos == theirs) {
+            chunk.columns[i]->addDefault();
+        } else {
+            chunk.columns[i]->pushFrom(*from.columns[theirs], row);
+        }
+    }
+    ++rows;
+    return Location{ this, &chunk, chunk.size() - 1 };
+}
+
+void Archetype::shiftRows(Chunk &from, Chunk &to, const size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const size_t row = from.size() - 1;
+        to.ids.push_back(from.ids[row]);
+        from.ids.pop_back();
+        for (size_t col = 0; col < to.columns.size(); ++col) {
+            to.columns[col]->pushFrom(*from.columns[col], row);
+            from.columns[col]->popBack();
+        }
+    }
+}
+
+size_t Archetype::splice(Archetype &other) {
+    rassert(signature == other.signature, "Splicing mismatched archetypes", signature, other.signature);
+    if (0 == other.rows) { return chunks.size(); }
+    std::unique_ptr< Chunk > partial;
+    if (!chunks.empty() && chunks.back()->size() < capacity) {
+        partial = std::move(chunks.back());
+        chunks.pop_back();
+    }
+    const size_t first = chunks.size();
+    for (auto &chunk : other.chunks) {
+        chunks.push_back(std::move(chunk));
+    }
+    rows += other.rows;
+    other.clear();
+
+    // Our old last chunk and their last chunk may both be partial, only one can stay that way
+    if (partial) {
+        Chunk &last = *chunks.back();
+        if (last.size() == capacity) {
+            chunks.push_back(std::move(partial));
+        } else if (partial->size() + last.size() <= capacity) {
+            if (partial->size() > last.size()) {
+                shiftRows(last, *partial, last.size());
+                chunks.back() = std::move(partial);
+            } else {
+                shiftRows(*partial, last, partial->size());
+            }
+        } else {
+            shiftRows(last, *partial, capacity - partial->size());
+            chunks.insert(chunks.end() - 1, std::move(partial));
+        }
+    }
+    for (size_t i = first; i < chunks.size(); ++i) {
+        chunks[i]->index = i;
+    }
+    return first;
+}
+
+EntityID Archetype::remove(Chunk &chunk, const size_t row) {
+    Chunk &last = *chunks.back();
+    const size_t lastRow = last.size() - 1;
+    EntityID moved = 0;
+    if (&last != &chunk || lastRow != row) {
+        moved = last.ids[lastRow];
+        chunk.ids[row] = moved;
+        for (size_t i = 0; i < chunk.columns.size(); ++i) {
+            chunk.columns[i]->assignFrom(row, *last.columns[i], lastRow);
+        }
+    }
+    last.ids.pop_back();
+    for (auto &col : last.columns) {
+        col->popBack();
+    }
+    if (0 == last.size()) {
+        chunks.pop_back();
+    }
+    --rows;
+    return moved;
+}
+
+void Archetype::removeRows(const std::vector< Location > &dead, std::vector< std::pair< EntityID, Location > > &moved) {
+    // Every chunk but the last is full, so rows can be numbered across chunks
+    std::vector< size_t > holes;
+    holes.reserve(dead.size());
+    for (const Location &loc : dead) {
+        holes.push_back(loc.chunk->index * capacity + loc.row);
+    }
+    std::sort(holes.begin(), holes.end());
+
+    // Survivors past the new end fill the holes before it, in order
+    const size_t kept = rows - holes.size();
+    const auto split = std::lower_bound(holes.begin(), holes.end(), kept);
+    auto skip = split;
+    size_t tail = kept;
+    for (auto hole = holes.begin(); hole != split; ++hole, ++tail) {
+        while (holes.end() != skip && *skip == tail) {
+            ++skip;
+            ++tail;
+        }
+        Chunk &from = *chunks[tail / capacity];
+        Chunk &to = *chunks[*hole / capacity];
+        const size_t fromRow = tail % capacity;
+        const size_t toRow = *hole % capacity;
+        to.ids[toRow] = from.ids[fromRow];
+        for (size_t i = 0; i < to.columns.size(); ++i) {
+            to.columns[i]->assignFrom(toRow, *from.columns[i], fromRow);
+        }
+        moved.emplace_back(to.ids[toRow], Location{ this, &to, toRow });
+    }
+
+    chunks.resize((kept + capacity - 1) / capacity);
+    if (!chunks.empty()) {
+        Chunk &last = *chunks.back();
+        const size_t size = kept - last.index * capacity;
+        last.ids.resize(size);
+        for (auto &col : last.columns) {
+            col->truncate(size);
+        }
+    }
+    rows = kept;
+}
+
+void Archetype::initComponents(Core &core, const Location &loc) {
+    const EntityID id = loc.chunk->ids[loc.row];
+    for (auto &col : loc.chunk->columns) {
+        col->initComponent(core, id, loc.row);
+    }
+}
+
+void Archetype::initRows(Core &core, Chunk &chunk, const size_t row, const size_t count) {
+    for (auto &col : chunk.columns) {
+        col->initComponents(core, chunk.ids.data() + row, row, count);
+    }
+}
+
+void Archetype::clear() {
+    chunks.clear();
+    rows = 0;
+}
+
+}
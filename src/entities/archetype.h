@@ -0,0 +1,117 @@
+#pragma once
+
+#include "entities/data.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <limits>
+#include <mutex>
+
+struct Core;
+
+namespace Entity {
+
+typedef uint64_t EntityID;
+typedef std::unique_ptr< BaseData > SourcePtr;
+typedef std::map< TypeID, SourcePtr > Sources;
+
+// A fixed capacity block of rows, holding one column per archetype type
+struct Chunk {
+    size_t index; // Position in its archetype's chunks
+    std::vector< EntityID > ids;
+    std::vector< std::unique_ptr< BaseColumn > > columns; // In Archetype::types order
+
+    size_t size() const { return ids.size(); }
+
+    template< typename T >
+    typename DataStorageType< std::remove_const_t< T > >::Type::ColumnType &column(const size_t col) {
+        using ColumnType = typename DataStorageType< std::remove_const_t< T > >::Type::ColumnType;
+        return static_cast< ColumnType & >(*columns[col]);
+    }
+
+    template< typename T >
+    const typename DataStorageType< std::remove_const_t< T > >::Type::ColumnType &column(const size_t col) const {
+        using ColumnType = typename DataStorageType< std::remove_const_t< T > >::Type::ColumnType;
+        return static_cast< const ColumnType & >(*columns[col]);
+    }
+};
+
+class Archetype;
+
+struct Location {
+    Archetype *archetype;
+    Chunk *chunk;
+    size_t row;
+};
+
+// All entities sharing a signature, stored as per type columns in chunks
+// Every chunk but the last is kept full, removals are filled from the last row
+class Archetype {
+    public:
+        static constexpr size_t CHUNK_BYTES = 16 * 1024;
+        static constexpr size_t npos = std::numeric_limits< size_t >::max();
+
+        const Signature signature;
+        const bool nursery;
+
+    private:
+        const Sources &sources;
+        OrderedSignature types;
+        std::vector< size_t > typeIndices; // Dense type index of each column
+        // Column of each type by dense type index, npos for types not held
+        std::vector< size_t > columns;
+        size_t capacity;
+        size_t rows;
+
+        Chunk &openChunk();
+        // Moves count rows off the end of one chunk onto the end of another
+        static void shiftRows(Chunk &from, Chunk &to, const size_t count);
+
+    public:
+        std::vector< std::unique_ptr< Chunk > > chunks;
+
+        Archetype(const Signature &sig, const bool nursery, const Sources &sources);
+
+        const OrderedSignature &getTypes() const;
+        const std::vector< size_t > &getTypeIndices() const;
+        size_t column(const size_t typeIndex) const;
+        size_t count() const;
+        size_t chunkCapacity() const;
+
+        // Adds a row of default constructed components
+        Location append(const EntityID id);
+        // Adds default rows for every id, filling whole chunks at a time
+        void appendMany(const std::vector< EntityID > &ids, std::vector< Location > &out);
+        // Moves a row in from another archetype, dropping the columns this one lacks
+        //      and default constructing the ones the other lacks
+        // The source row is left for the caller to remove
+        Location adopt(Archetype &other, Chunk &chunk, const size_t row);
+        // Takes every row of another archetype with the same signature, leaving it empty
+        // Whole chunks change hands, only rows needed to keep a single partial chunk are copied
+        // Returns the first chunk holding moved rows, those from it on need relocating
+        size_t splice(Archetype &other);
+        // Removes the row, and returns the id moved into its place (or 0 if none was)
+        EntityID remove(Chunk &chunk, const size_t row);
+        // Removes many rows in one pass, each survivor from the tail moves at most once
+        // Moved rows are added to moved with their new locations
+        void removeRows(const std::vector< Location > &dead, std::vector< std::pair< EntityID, Location > > &moved);
+
+        void initComponents(Core &core, const Location &loc);
+        void initRows(Core &core, Chunk &chunk, const size_t row, const size_t count);
+
+        void clear();
+};
+
+typedef std::vector< Archetype * > Archetypes;
+
+// Archetypes matching each of an Exec's packs, main pack first
+// Only archetypes past seen are new to it, so matching is incremental
+struct Query {
+    std::vector< Signature > signatures;
+    std::vector< Archetypes > matches;
+    size_t seen = 0;
+    std::mutex tex;
+};
+
+}
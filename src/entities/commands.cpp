@@ -0,0 +1,84 @@
+#include "entities/commands.h"
+#include "entities/tracker.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace Entity {
+
+namespace {
+
+thread_local CommandBuffer *k_current_buffer = nullptr;
+
+// Ids are reserved in batches, so spawning doesn't take the tracker's lock each time
+const size_t RESERVE_BATCH = 32;
+
+}
+
+CommandBuffer *CommandBuffer::current() {
+    return k_current_buffer;
+}
+
+CommandBuffer::Scope::Scope(CommandBuffer *buffer): previous(k_current_buffer) {
+    k_current_buffer = buffer;
+}
+
+CommandBuffer::Scope::~Scope() {
+    k_current_buffer = previous;
+}
+
+void CommandBuffer::refill(Tracker &tracker) {
+    const size_t want = std::max(RESERVE_BATCH, peak);
+    if (reserved.size() < want) {
+        tracker.reserveIDs(reserved, want - reserved.size());
+    }
+}
+
+EntityID CommandBuffer::reserve(Tracker &tracker) {
+    if (reserved.empty()) {
+        if (NO_LANE == lane) {
+            tracker.reserveIDs(reserved, RESERVE_BATCH);
+        } else {
+            tracker.reserveLaneIDs(reserved, lane);
+        }
+    }
+    const EntityID id = reserved.back();
+    reserved.pop_back();
+    ++used;
+    return id;
+}
+
+void CommandBuffer::record(Command command) {
+    commands.push_back(std::move(command));
+}
+
+void CommandBuffer::setLane(const size_t to) {
+    lane = to;
+}
+
+bool CommandBuffer::empty() const {
+    return commands.empty();
+}
+
+void CommandBuffer::absorb(CommandBuffer &other) {
+    commands.insert(commands.end(), std::make_move_iterator(other.commands.begin()), std::make_move_iterator(other.commands.end()));
+    reserved.insert(reserved.end(), other.reserved.begin(), other.reserved.end());
+    other.commands.clear();
+    other.reserved.clear();
+}
+
+void CommandBuffer::playback(Core &core, Tracker &tracker) {
+    peak = std::max(peak, used);
+    used = 0;
+    if (commands.empty() && reserved.empty()) { return; }
+    tracker.withWriteLock([&](){
+        for (const auto &command : commands) {
+            command(core);
+        }
+        tracker.releaseIDs(reserved);
+    });
+    commands.clear();
+    reserved.clear();
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "entities/archetype.h"
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+struct Core;
+
+namespace Entity {
+
+class Tracker;
+
+// Structural changes recorded instead of applied, so systems don't contend on the tracker
+// SystemManager gives each system its own buffer while it runs,
+//      and plays them back in registration order once every system has run
+class CommandBuffer {
+    public:
+        typedef std::function< void(Core &) > Command;
+
+    private:
+        std::vector< Command > commands;
+        std::vector< EntityID > reserved; // Ids taken from the tracker, not yet handed out
+        // Ids handed out since the last playback, and the most ever handed out between two
+        size_t used = 0;
+        size_t peak = 0;
+        // The tracker lane this buffer takes ids from when it runs out, if it has one
+        size_t lane = NO_LANE;
+
+    public:
+        static constexpr size_t NO_LANE = std::numeric_limits< size_t >::max();
+
+        // The calling thread's buffer, if it has one
+        static CommandBuffer *current();
+
+        // Makes a buffer the calling thread's current one until the scope ends
+        class Scope {
+            CommandBuffer *previous;
+            public:
+                Scope(CommandBuffer *buffer);
+                ~Scope();
+        };
+
+        // Takes ids up front, as many as this buffer has ever handed out between playbacks
+        // SystemManager refills every system's buffer in registration order before the systems run,
+        //      so which ids a system's entities get doesn't depend on which threads got to the tracker first
+        void refill(Tracker &tracker);
+        // An id for an entity that will exist once this buffer is played back
+        // Note: Past what was refilled, ids come from the buffer's lane, or the tracker's free list without one
+        EntityID reserve(Tracker &tracker);
+        void setLane(const size_t lane);
+        void record(Command command);
+        bool empty() const;
+        // Moves another buffer's commands after ours, along with its unused ids
+        void absorb(CommandBuffer &other);
+
+        // Applies every command in order under the tracker's write lock,
+        //      and gives back any ids left unused
+        void playback(Core &core, Tracker &tracker);
+};
+
+}
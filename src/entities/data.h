@@ -1,9 +1,10 @@
 #pragma once
 
-#include <map>
 #include <string>
+#include <memory>
 #include <vector>
 #include <optional>
+#include <algorithm>
 #include <iostream>
 #include <typeindex>
 #include <functional>
@@ -13,23 +14,44 @@
 #include "utility/utility.h"
 #include "utility/templates.h"
 #include "entities/signature.h"
+#include "entities/view.h"
+#include "entities/multi.h"
 
 struct Core;
 
 namespace Entity {
 
+// Storage for one component type across the rows of a chunk
+class BaseColumn {
+    public:
+        virtual ~BaseColumn() { }
+        virtual size_t size() const = 0;
+        virtual void addDefault() = 0;
+        virtual void addDefaults(const size_t count) = 0;
+        // Appends the other column's row, leaving a moved-from husk behind
+        virtual void pushFrom(BaseColumn &other, const size_t row) = 0;
+        // Overwrites row with the other column's row
+        virtual void assignFrom(const size_t row, BaseColumn &other, const size_t otherRow) = 0;
+        virtual void popBack() = 0;
+        // Drops every row from size on
+        virtual void truncate(const size_t size) = 0;
+        virtual void initComponent(Core &core, const uint64_t id, const size_t row) = 0;
+        // Runs the init hook for count rows from row, ids holds each row's entity
+        virtual void initComponents(Core &core, const uint64_t *ids, const size_t row, const size_t count) = 0;
+        virtual void deleteComponent(Core &core, const uint64_t id, const size_t row) = 0;
+};
+
+// Describes a registered component type, and makes its columns
 class BaseData {
     public:
         virtual ~BaseData() { }
         virtual bool isMulti() const = 0;
-        virtual size_t has(const uint64_t id) const = 0;
-        virtual void add(const uint64_t id) = 0;
-        virtual void reserve(const size_t more) = 0;
-        virtual void remove(const uint64_t id) = 0;
-        virtual void initComponent(Core &core, const uint64_t id) = 0;
-        virtual void deleteComponent(Core &core, const uint64_t id) = 0;
-        virtual void graduateFrom(BaseData &other) = 0;
+        virtual size_t rowSize() const = 0;
+        virtual std::unique_ptr< BaseColumn > makeColumn(const size_t capacity) const = 0;
         virtual TypeID type() const = 0;
+        // Runs the delete hooks for a kill set, row i of columns[i] belongs to ids[i]
+        virtual void deleteRows(Core &core, const std::vector< uint64_t > &ids,
+                                const std::vector< BaseColumn * > &columns, const std::vector< size_t > &rows) const = 0;
 };
 std::ostream &operator<<(std::ostream &os, const BaseData &bd);
 
@@ -60,7 +82,7 @@ struct BaseFromSingle {
         typedef Entity::Data< T > Type; \
         typedef std::false_type IsMulti; \
         typedef T Single; \
-        typedef std::vector< T > Container; \
+        typedef Entity::View< T > Container; \
     }; \
     template<> struct Entity::ConstySingle< T > { \
         using Type = T; \
@@ -69,10 +91,10 @@ struct BaseFromSingle {
         using Type = const T; \
     }; \
     template<> struct Entity::ConstyContainer< T > { \
-        using Type = std::vector< T >; \
+        using Type = Entity::View< T >; \
     }; \
     template<> struct Entity::ConstyContainer< const T > { \
-        using Type = const std::vector< T >; \
+        using Type = const Entity::View< const T >; \
     }; \
     template<> struct Entity::BaseFromSingle< T > { \
         using Type = T; \
@@ -83,22 +105,22 @@ struct BaseFromSingle {
     template<> struct Entity::DataStorageType< T > { \
         typedef Entity::MultiData< T > Type; \
         typedef std::true_type IsMulti; \
-        typedef std::vector< T > Single; \
-        typedef std::vector< std::vector< T > > Container; \
+        typedef Entity::Multi< T > Single; \
+        typedef Entity::View< Entity::Multi< T > > Container; \
     }; \
     template<> struct Entity::ConstySingle< T > { \
-        using Type = std::vector< T >; \
+        using Type = Entity::Multi< T >; \
     }; \
     template<> struct Entity::ConstySingle< const T > { \
-        using Type = const std::vector< T >; \
+        using Type = const Entity::Multi< T >; \
     }; \
     template<> struct Entity::ConstyContainer< T > { \
-        using Type = std::vector< std::vector< T > >; \
+        using Type = Entity::View< Entity::Multi< T > >; \
     }; \
     template<> struct Entity::ConstyContainer< const T > { \
-        using Type = const std::vector< std::vector< T > >; \
+        using Type = const Entity::View< const Entity::Multi< T > >; \
     }; \
-    template<> struct Entity::BaseFromSingle< std::vector< T > > { \
+    template<> struct Entity::BaseFromSingle< Entity::Multi< T > > { \
         using Type = T; \
     };
 
@@ -108,259 +130,309 @@ void initComponent(Core &, uint64_t, T &) { }
 template< typename T >
 void deleteComponent(Core &, uint64_t, T &) { }
 
+// Batch form used when reaping, specialise it to share setup (like a lock) across the kill set
 template< typename T >
-class Data: public BaseData {
+void deleteComponents(Core &core, const std::vector< uint64_t > &ids, const std::vector< T * > &components) {
+    for (size_t i = 0; i < ids.size(); ++i) {
+        Entity::deleteComponent< T >(core, ids[i], *components[i]);
+    }
+}
+
+template< typename T >
+class Column: public BaseColumn {
     public:
-        typedef T Type;
-        bool isMulti() const { return false; }
-        TypeID type() const override { return DataTypeID< T >(); }
-        std::map< uint64_t, size_t > idToLow; // Converts from id to data index
-        std::map< size_t, uint64_t > lowToid; // Converts from data index to id
+        typedef T Row;
         std::vector< T > data;
-        virtual ~Data() { }
-
-        void graduateFrom(BaseData &baseOther) override {
-            rassert(type() == baseOther.type(), "Cannot graduate from a different type!", type(), baseOther.type());
-            Data< T > &other = static_cast< Data< T > & >(baseOther);
-
-            data.reserve(data.size() + other.data.size());
-            for (size_t i = 0; i < other.data.size(); ++i) {
-                const uint64_t id = other.lowToid[i];
-                idToLow[id] = data.size();
-                lowToid[data.size()] = id;
-                data.emplace_back(other.data[i]);
-            }
 
-            other.idToLow.clear();
-            other.lowToid.clear();
-            other.data.clear();
+        Column(const size_t capacity) {
+            data.reserve(capacity);
         }
+        virtual ~Column() { }
 
-        size_t has(const uint64_t id) const override {
-            return idToLow.find(id) != idToLow.end() ? 1 : 0;
+        size_t size() const override {
+            return data.size();
         }
 
-        T &forID(const uint64_t id) {
-            const auto id_loc = idToLow.find(id);
-            rassert(id_loc != idToLow.end(), "Entity does not have component", id, DataTypeName< T >());
-            const size_t index = id_loc->second;
-            rassert(index < data.size(), "Data chunk size is inconsistent", id, DataTypeName< T >());
-            return data.at(index);
+        void addDefault() override {
+            data.emplace_back();
         }
 
-        const T &forID(const uint64_t id) const {
-            const auto id_loc = idToLow.find(id);
-            rassert(id_loc != idToLow.end(), "Entity does not have component", id, DataTypeName< T >());
-            const size_t index = id_loc->second;
-            rassert(index < data.size(), "Data chunk size is inconsistent", id, DataTypeName< T >());
-            return data.at(index);
+        void addDefaults(const size_t count) override {
+            data.resize(data.size() + count);
         }
 
-        void addForID(const uint64_t id, std::vector< T > &data) const {
-            data.push_back(forID(id));
+        void pushFrom(BaseColumn &other, const size_t row) override {
+            data.emplace_back(std::move(static_cast< Column< T > & >(other).data[row]));
         }
 
-        void setForID(const uint64_t id, T &ref) {
-            const auto id_loc = idToLow.find(id);
-            rassert(id_loc != idToLow.end(), "Entity does not have component", id, DataTypeName< T >());
-            const size_t index = id_loc->second;
-            rassert(index < data.size(), "Data chunk size is inconsistent", id, DataTypeName< T >());
-            data[index] = std::move(ref);
+        void assignFrom(const size_t row, BaseColumn &other, const size_t otherRow) override {
+            data[row] = std::move(static_cast< Column< T > & >(other).data[otherRow]);
         }
 
-        std::optional< std::reference_wrapper< T > > optForID(const uint64_t id) {
-            const auto id_loc = idToLow.find(id);
-            if (idToLow.end() == id_loc) {
-                return std::nullopt;
-            }
-            const size_t index = id_loc->second;
-            rassert(index < data.size(), "Data chunk size is inconsistent", id, DataTypeName< T >());
-            return std::optional< std::reference_wrapper< T > >{data.at(index)};
+        void popBack() override {
+            data.pop_back();
         }
 
-        std::optional< std::reference_wrapper< const T > > optForID(const uint64_t id) const {
-            const auto id_loc = idToLow.find(id);
-            if (idToLow.end() == id_loc) {
-                return std::nullopt;
-            }
-            const size_t index = id_loc->second;
-            rassert(index < data.size(), "Data chunk size is inconsistent", id, DataTypeName< T >());
-            return std::optional< std::reference_wrapper< const T > >{data.at(index)};
+        void truncate(const size_t size) override {
+            data.erase(data.begin() + size, data.end());
         }
 
-        void reserve(const size_t more) override {
-            data.reserve(data.size() + more);
+        void put(const size_t row, const T &t) {
+            data[row] = t;
         }
 
-        void add(const uint64_t id) override {
-            idToLow[id] = data.size();
-            lowToid[data.size()] = id;
-            data.resize(data.size() + 1);
+        void put(const size_t row, T &&t) {
+            data[row] = std::move(t);
         }
 
-        void addThis(const uint64_t id, const T &t) {
-            idToLow[id] = data.size();
-            lowToid[data.size()] = id;
-            data.emplace_back(t);
+        void initComponent(Core &core, const uint64_t id, const size_t row) override {
+            Entity::initComponent< T >(core, id, data[row]);
         }
 
-        void remove(const uint64_t id) override {
-            const size_t back = data.size() - 1;
-            const size_t backID = lowToid[back];
-            const size_t eraseAt = idToLow[id];
-            if (id != backID) {
-                data[eraseAt] = std::move(data[back]);
-                idToLow[backID] = eraseAt;
-                lowToid[eraseAt] = backID;
+        void initComponents(Core &core, const uint64_t *ids, const size_t row, const size_t count) override {
+            for (size_t i = 0; i < count; ++i) {
+                Entity::initComponent< T >(core, ids[i], data[row + i]);
             }
-            data.resize(data.size() - 1);
-            lowToid.erase(back);
-            idToLow.erase(id);
-        }
-
-        void initComponent(Core &core, const uint64_t id) override {
-            T &t = data[idToLow[id]];
-            Entity::initComponent< T >(core, id, t);
         }
 
-        void deleteComponent(Core &core, const uint64_t id) override {
-            T &t = data[idToLow[id]];
-            Entity::deleteComponent< T >(core, id, t);
+        void deleteComponent(Core &core, const uint64_t id, const size_t row) override {
+            Entity::deleteComponent< T >(core, id, data[row]);
         }
 };
 
+// Every instance in the chunk lives in one flat array, each row is a span of it in insertion order
+// A row owns a block with some slack, when that fills the block moves to the end with twice the room
+// The holes left behind are packed away once they're half the array
 template< typename T >
-class MultiData: public BaseData {
+class MultiColumn: public BaseColumn {
     public:
-        typedef T Type;
-        bool isMulti() const { return true; }
-        TypeID type() const override { return DataTypeID< T >(); }
-        std::map< uint64_t, std::vector< size_t > > idToLow; // Converts from id to data index
-        std::map< size_t, uint64_t > lowToid; // Converts from data index to id
-        std::vector< T > data;
-        virtual ~MultiData() { }
-
-        void graduateFrom(BaseData &baseOther) override {
-            rassert(type() == baseOther.type(), "Cannot graduate from a different type!", type(), baseOther.type());
-            MultiData< T > &other = static_cast< MultiData< T > & >(baseOther);
+        typedef Multi< T > Row;
+        std::vector< Row > data;
+
+    private:
+        struct Extent {
+            size_t offset;
+            size_t capacity;
+        };
+
+        std::vector< T > values;
+        std::vector< Extent > extents;
+        size_t holes = 0;
+
+        Row span(const size_t row, const size_t count) {
+            if (0 == extents[row].capacity) { return Row(); }
+            return Row(values.data() + extents[row].offset, count);
+        }
 
-            data.reserve(data.size() + other.data.size());
-            for (size_t i = 0; i < other.data.size(); ++i) {
-                const uint64_t id = other.lowToid[i];
-                idToLow[id].push_back(data.size());
-                lowToid[data.size()] = id;
-                data.emplace_back(other.data[i]);
+        void rebase() {
+            for (size_t row = 0; row < data.size(); ++row) {
+                data[row] = span(row, data[row].size());
             }
+        }
 
-            other.idToLow.clear();
-            other.lowToid.clear();
-            other.data.clear();
+        // A new block at the end of values
+        size_t allocate(const size_t capacity) {
+            const size_t offset = values.size();
+            const T *before = values.data();
+            values.resize(offset + capacity);
+            if (values.data() != before) { rebase(); }
+            return offset;
         }
 
-        size_t has(const uint64_t id) const override {
-            const auto loc = idToLow.find(id);
-            if (idToLow.end() == loc) { return 0; }
-            return loc->second.size();
+        void release(const size_t row) {
+            const Extent &ext = extents[row];
+            if (ext.offset + ext.capacity == values.size()) {
+                values.resize(ext.offset);
+            } else {
+                holes += ext.capacity;
+            }
         }
 
-        void setForID(const uint64_t id, std::vector< T > &refs) {
-            rassert(!data.empty(), "You must exactly set at least one value", id, DataTypeName< T >());
-            const auto id_loc = idToLow.find(id);
-            rassert(id_loc != idToLow.end(), "Entity does not have component", id, DataTypeName< T >());
-            const auto &indices = id_loc->second;
-            rassert(indices.size() == refs.size(), "You must set as many components as the entity has",
-                    id, indices.size(), refs.size(), DataTypeName< T >());
-            for (size_t i = 0; i < refs.size(); ++i) {
-                data[indices[i]] = refs[i];
+        void compact() {
+            if (holes * 2 <= values.size()) { return; }
+            std::vector< T > packed;
+            packed.reserve(values.size() - holes);
+            for (size_t row = 0; row < data.size(); ++row) {
+                const size_t count = data[row].size();
+                Extent &ext = extents[row];
+                const size_t offset = packed.size();
+                for (size_t i = 0; i < count; ++i) {
+                    packed.push_back(std::move(values[ext.offset + i]));
+                }
+                ext = Extent{ offset, count };
             }
+            values = std::move(packed);
+            holes = 0;
+            rebase();
         }
 
-        std::vector< T > forID(const uint64_t id) const {
-            std::vector< T > refs;
-            for (const size_t index : idToLow.at(id)) {
-                refs.push_back(data[index]);
+        // Makes room for one more instance in row, and returns it
+        T &grow(const size_t row) {
+            const size_t count = data[row].size();
+            if (count == extents[row].capacity) {
+                const size_t capacity = std::max(size_t(2), 2 * count);
+                if (extents[row].offset + extents[row].capacity == values.size()) {
+                    allocate(capacity - count);
+                } else {
+                    const size_t offset = allocate(capacity);
+                    for (size_t i = 0; i < count; ++i) {
+                        values[offset + i] = std::move(values[extents[row].offset + i]);
+                    }
+                    release(row);
+                    extents[row].offset = offset;
+                }
+                extents[row].capacity = capacity;
             }
-            return refs;
+            data[row] = span(row, count + 1);
+            return values[extents[row].offset + count];
+        }
+
+    public:
+        MultiColumn(const size_t capacity) {
+            data.reserve(capacity);
+            extents.reserve(capacity);
+        }
+        virtual ~MultiColumn() { }
+
+        size_t size() const override {
+            return data.size();
         }
 
-        void addForID(const uint64_t id, std::vector< std::vector< T > > &refs) const {
-            refs.emplace_back(forID(id));
+        void addDefault() override {
+            extents.push_back(Extent{ values.size(), 0 });
+            data.emplace_back();
         }
 
-        std::vector< std::reference_wrapper< T > > optForID(const uint64_t id) {
-            std::vector< std::reference_wrapper< T > > refs;
-            const auto loc = idToLow.find(id);
-            if (idToLow.end() == loc) { return refs; }
-            for (const size_t index : *loc) {
-                refs.push_back(data[index]);
+        void addDefaults(const size_t count) override {
+            for (size_t i = 0; i < count; ++i) {
+                addDefault();
             }
-            return refs;
         }
 
-        std::vector< std::reference_wrapper< const T > > optForID(const uint64_t id) const {
-            std::vector< std::reference_wrapper< const T > > refs;
-            const auto loc = idToLow.find(id);
-            if (idToLow.end() == loc) { return refs; }
-            for (const size_t index : *loc) {
-                refs.push_back(data[index]);
+        void pushFrom(BaseColumn &other, const size_t row) override {
+            auto &from = static_cast< MultiColumn< T > & >(other);
+            const size_t count = from.data[row].size();
+            const size_t offset = allocate(count);
+            for (size_t i = 0; i < count; ++i) {
+                values[offset + i] = std::move(from.data[row][i]);
             }
-            return refs;
+            extents.push_back(Extent{ offset, count });
+            data.push_back(span(data.size(), count));
         }
 
-        void reserve(const size_t more) override {
-            data.reserve(data.size() + more);
+        void assignFrom(const size_t row, BaseColumn &other, const size_t otherRow) override {
+            auto &from = static_cast< MultiColumn< T > & >(other);
+            if (&from == this && row == otherRow) { return; }
+            const size_t count = from.data[otherRow].size();
+            if (extents[row].capacity < count) {
+                release(row);
+                extents[row] = Extent{ allocate(count), count };
+            }
+            // Offsets rather than the span, allocating may have moved the other rows
+            const size_t theirs = from.extents[otherRow].offset;
+            for (size_t i = 0; i < count; ++i) {
+                values[extents[row].offset + i] = std::move(from.values[theirs + i]);
+            }
+            data[row] = span(row, count);
+            compact();
         }
 
-        void add(const uint64_t id) override {
-            idToLow[id].push_back(data.size());
-            lowToid[data.size()] = id;
-            data.resize(data.size() + 1);
+        void popBack() override {
+            release(data.size() - 1);
+            extents.pop_back();
+            data.pop_back();
+            compact();
         }
 
-        void addThis(const uint64_t id, const T &t) {
-            idToLow[id].push_back(data.size());
-            lowToid[data.size()] = id;
-            data.emplace_back(t);
+        void truncate(const size_t size) override {
+            while (data.size() > size) {
+                release(data.size() - 1);
+                extents.pop_back();
+                data.pop_back();
+            }
+            compact();
         }
 
-        void remove(const uint64_t id) override {
-            // Warning: This removes all of them for this id
-            // TODO: This could probably be more efficient
-            size_t back = data.size() - 1;
-            for (const size_t erase_at : idToLow[id]) {
-                if (erase_at == back) {
-                    lowToid.erase(back);
-                    // idToLow will be deleted in bulk later
-                    --back;
-                    continue;
-                }
+        void put(const size_t row, const T &t) {
+            grow(row) = t;
+            compact();
+        }
+
+        void put(const size_t row, T &&t) {
+            grow(row) = std::move(t);
+            compact();
+        }
+
+        void initComponent(Core &core, const uint64_t id, const size_t row) override {
+            for (T &t : data[row]) {
+                Entity::initComponent< T >(core, id, t);
+            }
+        }
 
-                data[erase_at] = std::move(data[back]);
-                const auto backID = lowToid[back];
-                lowToid[erase_at] = backID;
-                auto &siblings = idToLow[backID];
-                auto loc = std::find(siblings.begin(), siblings.end(), back);
-                *loc = erase_at;
-                --back;
+        void initComponents(Core &core, const uint64_t *ids, const size_t row, const size_t count) override {
+            for (size_t i = 0; i < count; ++i) {
+                initComponent(core, ids[i], row + i);
             }
-            data.resize(back + 1);
-            idToLow.erase(id);
         }
 
-        void initComponent(Core &core, const uint64_t id) override {
-            const auto loc = idToLow.find(id);
-            rassert(loc != idToLow.end(), "Entity does not have component", id, DataTypeName< T >());
-            for (const size_t index : loc->second) {
-                Entity::initComponent< T >(core, id, data[index]);
+        void deleteComponent(Core &core, const uint64_t id, const size_t row) override {
+            for (T &t : data[row]) {
+                Entity::deleteComponent< T >(core, id, t);
             }
         }
+};
+
+template< typename T >
+class Data: public BaseData {
+    public:
+        typedef T Type;
+        typedef Column< T > ColumnType;
+        virtual ~Data() { }
+        bool isMulti() const override { return false; }
+        size_t rowSize() const override { return sizeof(T); }
+        TypeID type() const override { return DataTypeID< T >(); }
 
-        void deleteComponent(Core &core, const uint64_t id) override {
-            const auto loc = idToLow.find(id);
-            rassert(loc != idToLow.end(), "Entity does not have component", id, DataTypeName< T >());
-            for (const size_t index : loc->second) {
-                Entity::deleteComponent< T >(core, id, data[index]);
+        std::unique_ptr< BaseColumn > makeColumn(const size_t capacity) const override {
+            return std::make_unique< ColumnType >(capacity);
+        }
+
+        void deleteRows(Core &core, const std::vector< uint64_t > &ids,
+                        const std::vector< BaseColumn * > &columns, const std::vector< size_t > &rows) const override {
+            std::vector< T * > components;
+            components.reserve(ids.size());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                components.push_back(&static_cast< ColumnType * >(columns[i])->data[rows[i]]);
+            }
+            Entity::deleteComponents< T >(core, ids, components);
+        }
+};
+
+template< typename T >
+class MultiData: public BaseData {
+    public:
+        typedef T Type;
+        typedef MultiColumn< T > ColumnType;
+        virtual ~MultiData() { }
+        bool isMulti() const override { return true; }
+        // A guess of one instance a row, multi rows aren't fixed size
+        size_t rowSize() const override { return sizeof(typename ColumnType::Row) + 2 * sizeof(size_t) + sizeof(T); }
+        TypeID type() const override { return DataTypeID< T >(); }
+
+        std::unique_ptr< BaseColumn > makeColumn(const size_t capacity) const override {
+            return std::make_unique< ColumnType >(capacity);
+        }
+
+        void deleteRows(Core &core, const std::vector< uint64_t > &ids,
+                        const std::vector< BaseColumn * > &columns, const std::vector< size_t > &rows) const override {
+            std::vector< uint64_t > owners;
+            std::vector< T * > components;
+            for (size_t i = 0; i < ids.size(); ++i) {
+                for (T &t : static_cast< ColumnType * >(columns[i])->data[rows[i]]) {
+                    owners.push_back(ids[i]);
+                    components.push_back(&t);
+                }
             }
+            Entity::deleteComponents< T >(core, owners, components);
         }
 };
 
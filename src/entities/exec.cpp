@@ -1,14 +1,69 @@
 #include "entities/exec.h"
+#include "entities/systems.h"
+#include "entities/commands.h"
 
 namespace Entity {
 
 AccumulateTimer *k_entity_timer = nullptr;
 
 std::mutex entity_timer_mutex;
+HistogramTimer gather_latency;
+HistogramTimer query_latency;
 
 void addEntityTime(std::chrono::duration< double > seconds) {
     std::unique_lock lock(entity_timer_mutex);
     k_entity_timer->add(seconds);
+    gather_latency.add(seconds);
+}
+
+void addQueryTime(std::chrono::duration< double > seconds) {
+    std::unique_lock lock(entity_timer_mutex);
+    query_latency.add(seconds);
+}
+
+HistogramTimer::Summary emptyGatherLatency() {
+    std::unique_lock lock(entity_timer_mutex);
+    return gather_latency.empty();
+}
+
+HistogramTimer::Summary emptyQueryLatency() {
+    std::unique_lock lock(entity_timer_mutex);
+    return query_latency.empty();
+}
+
+void ParallelScratch::run(const size_t i) {
+    // Always scoped, a helping thread may be inside some other system's scope
+    CommandBuffer::Scope scope(parent ? &buffers[i] : nullptr);
+    AccessScope access(system);
+    RandomScope stream(seed + i);
+    (*tasks)[i]();
+}
+
+void runParallel(SystemManager &systems, const std::vector< std::function< void() > > &tasks) {
+    ParallelScratch scratch;
+    runParallel(systems, tasks, scratch);
+}
+
+void runParallel(SystemManager &systems, const std::vector< std::function< void() > > &tasks, ParallelScratch &scratch) {
+    scratch.parent = CommandBuffer::current();
+    scratch.system = AccessScope::current();
+    // Each task draws from its own stream, so the numbers don't depend on which thread took which
+    scratch.seed = randomStream()();
+    scratch.tasks = &tasks;
+    scratch.buffers.resize(scratch.parent ? tasks.size() : 0);
+    // Small enough for std::function to keep inline, so refilling the wrappers doesn't allocate
+    scratch.scoped.resize(tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        scratch.scoped[i] = [&scratch, i]() { scratch.run(i); };
+    }
+    systems.runTasks(scratch.scoped);
+    for (auto &buffer : scratch.buffers) {
+        scratch.parent->absorb(buffer);
+    }
+}
+
+size_t parallelWidth(SystemManager &systems) {
+    return systems.width();
 }
 
 }
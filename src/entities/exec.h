@@ -3,19 +3,67 @@
 #include "utility/typelist.h"
 #include "entities/tracker.h"
 #include "entities/pack.h"
+#include "entities/access.h"
 #include "utility/timers.h"
+#include "utility/trace.h"
 
 #include <utility>
+#include <array>
+#include <algorithm>
+#include <functional>
 #include <chrono>
 #include <vector>
 #include <mutex>
+#include <typeinfo>
 
 namespace Entity {
 
+class SystemManager;
+
 extern AccumulateTimer *k_entity_timer;
 void addEntityTime(std::chrono::duration< double > seconds);
+// Every query's time running its function over what it gathered
+void addQueryTime(std::chrono::duration< double > seconds);
+// Latencies of the queries' gathers and runs since the last call
+HistogramTimer::Summary emptyGatherLatency();
+HistogramTimer::Summary emptyQueryLatency();
+
+using IDMap = View< const EntityID >;
+
+// The rows of one pack a parallel task covers
+struct Slice {
+    size_t pack;
+    size_t first;
+    size_t last;
+
+    // The task's rows of pack p, empty unless it's the slice's own pack
+    size_t begin(const size_t p) const { return (p == pack) ? first : 0; }
+    size_t end(const size_t p) const { return (p == pack) ? last : 0; }
+};
+
+// For parallel runs that have nothing to reduce
+struct NoReduction { };
+
+// Runs tasks on the system pool, each recording structural changes into its own buffer
+// Those are folded into the calling system's buffer in task order, so playback doesn't depend on timing
+// Tasks are held to the calling system's access, whichever thread runs them
+void runParallel(SystemManager &systems, const std::vector< std::function< void() > > &tasks);
+
+// What runParallel wraps the tasks in, kept by systems that split up the same way every tick so it doesn't allocate
+class ParallelScratch {
+    CommandBuffer *parent = nullptr;
+    const BaseSystem *system = nullptr;
+    uint64_t seed = 0;
+    const std::vector< std::function< void() > > *tasks = nullptr;
+    std::vector< CommandBuffer > buffers;
+    std::vector< std::function< void() > > scoped;
 
-using IDMap = std::vector< EntityID >;
+    void run(const size_t i);
+
+    friend void runParallel(SystemManager &, const std::vector< std::function< void() > > &, ParallelScratch &);
+};
+void runParallel(SystemManager &systems, const std::vector< std::function< void() > > &tasks, ParallelScratch &scratch);
+size_t parallelWidth(SystemManager &systems);
 
 template< typename ...Packs >
 using ExecFunc = std::function< void(std::pair< Packs, const IDMap > &...) >;
@@ -23,132 +71,149 @@ using ExecFunc = std::function< void(std::pair< Packs, const IDMap > &...) >;
 template< typename MainPack, typename ...Packss >
 struct Exec {
     using Func = ExecFunc< MainPack, Packss... >;
+    template< typename Acc >
+    using ParallelFunc = std::function< void(std::pair< MainPack, const IDMap > &, std::pair< Packss, const IDMap > &..., const Slice &, Acc &) >;
+    static constexpr size_t PackCount = 1 + sizeof...(Packss);
+    // Fewest rows worth handing to a task
+    static constexpr size_t PARALLEL_GRAIN = 64;
 
-    template< typename Type >
-    static void getData(std::vector< Type > &v, const std::vector< EntityID > &ids, Tracker &tracker) {
-        using BaseType = BaseFromSingle< Type >::Type;
-        v.reserve(ids.size());
+    using Internal = std::tuple< std::pair< MainPack, IDMap >, std::pair< Packss, IDMap > ... >;
+    using External = std::tuple< std::pair< MainPack, const IDMap >, std::pair< Packss, const IDMap > ... >;
 
-        const BaseData &baseSource = tracker.getSource< BaseType >();
-        const typename DataStorageType< BaseType >::Type &source = static_cast< const DataStorageType< BaseType >::Type & >(baseSource);
-        for (const auto id : ids) {
-            source.addForID(id, v);
-        }
+    static std::vector< Signature > signatures() {
+        return { MainPack::signature(), Packss::signature()... };
     }
 
-    template< typename ...Types >
-    static void getIndices(const std::pair< Packs< Types... >, IDMap >&, Tracker &tracker, std::set< EntityID > &ids) {
-        const Signature sig = getSignature< Types... >();
-        for (auto &group : tracker.entities) {
-            if (typesSubset(group.first, sig)) {
-                for (const auto EID : group.second) {
-                    ids.insert(EID);
-                }
-            }
-        }
+    // What a system running this reads and writes, for it to declare
+    static ConstySignature access() {
+        ConstySignature sig = MainPack::access();
+        (..., (sig |= Packss::access()));
+        return sig;
     }
 
-    template< typename ...Types >
-    static void populateMain(std::pair< Packs< Types... >, IDMap > &pair, Tracker &tracker, std::set< EntityID > &ids) {
-        pair.second = decltype(pair.second)(ids.begin(), ids.end());
-        using Muta = typename Packs< std::remove_const_t< Types > ... >::Mutable;
+    template< typename Type, typename ...Types >
+    static void addView(Packs< Types... > &packs, Chunk &chunk, const size_t col) {
         using FI = FindIndices< Types... >;
-        // This gets a non-const version of the data
-        // I hope non-consts have the same alignments as consts
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Wstrict-aliasing"
-        Muta &muta = reinterpret_cast< Muta & >(pair.first.data);
-        #pragma GCC diagnostic pop
-        (..., getData(std::get< FI::template index< Types >() >(muta), pair.second, tracker));
+        auto &rows = chunk.template column< Type >(col).data;
+        std::get< FI::template index< Type >() >(packs.data).add(rows.data(), rows.size());
     }
 
     template< typename ...Types >
-    static void populate(std::pair< Packs< Types... >, IDMap > &pair, Tracker &tracker, std::set< EntityID > &ids) {
-        const Signature sig = getSignature< Types... >();
-        for (auto &group : tracker.entities) {
-            if (typesSubset(group.first, sig)) {
-                for (const auto EID : group.second) {
-                    const auto loc = ids.find(EID);
-                    if (ids.end() != loc) {
-                        ids.erase(loc);
-                        pair.second.push_back(EID);
-                    }
-                }
+    static void populate(std::pair< Packs< Types... >, IDMap > &pair, const Archetypes &archetypes) {
+        size_t chunks = 0;
+        for (const Archetype *arch : archetypes) {
+            chunks += arch->chunks.size();
+        }
+        if (0 == chunks) { return; }
+        pair.second.reserve(chunks);
+        std::apply([&](auto &...views) { (..., views.reserve(chunks)); }, pair.first.data);
+        for (Archetype *arch : archetypes) {
+            if (0 == arch->count()) { continue; }
+            const std::array< size_t, sizeof...(Types) > cols = { arch->column(DataTypeIndex< std::remove_const_t< Types > >())... };
+            for (const auto &chunk : arch->chunks) {
+                pair.second.add(chunk->ids.data(), chunk->size());
+                size_t col = 0;
+                (..., addView< Types >(pair.first, *chunk, cols[col++]));
             }
         }
-        using Muta = typename Packs< std::remove_const_t< Types > ... >::Mutable;
-        using FI = FindIndices< Types... >;
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Wstrict-aliasing"
-        Muta &muta = reinterpret_cast< Muta & >(pair.first.data);
-        #pragma GCC diagnostic pop
-        (..., getData(std::get< FI::template index< Types >() >(muta), pair.second, tracker));
     }
 
-    template< typename Type >
-    static typename std::enable_if< std::is_const< Type >::value, void >::type
-    setData(const DataStorageType< std::remove_const_t< Type > >::Container &, const std::vector< EntityID > &, Tracker &) {
-        // Do nothing
+    template< typename Internal, size_t ...I >
+    static void populateAll(Internal &data, const std::vector< Archetypes > &matches, std::index_sequence< I... >) {
+        (..., populate(std::get< I >(data), matches[I]));
     }
 
-    template< typename Type >
-    static typename std::enable_if< !std::is_const< Type >::value, void >::type
-    setData(DataStorageType< std::remove_const_t< Type > >::Container &v, const std::vector< EntityID > &ids, Tracker &tracker) {
-        BaseData &baseSource = tracker.getSource< Type >();
-        typename DataStorageType< Type >::Type &source = static_cast< DataStorageType< Type >::Type & >(baseSource);
-        for  (size_t i = 0; i < ids.size(); ++i) {
-            source.setForID(ids[i], v[i]);
-        }
+    static void gather(Tracker &tracker, Internal &data) {
+        CHECK_ACCESS_TO(access(), "query");
+        Trace::Span span("Gather");
+        const auto start = std::chrono::high_resolution_clock::now();
+        tracker.withReadLock([&]() {
+            Query &query = tracker.getQuery(typeid(Exec), &signatures);
+            std::lock_guard< std::mutex > lock(query.tex);
+            tracker.updateQuery(query);
+            populateAll(data, query.matches, std::make_index_sequence< PackCount >{});
+        });
+        addEntityTime(std::chrono::high_resolution_clock::now() - start);
     }
 
-    template< typename ...Types >
-    struct WriteExtractor {
-        template< typename Type >
-        static void wb(std::pair< Packs< Types... >, IDMap > &pair, Tracker &tracker) {
-            setData< Type >(pair.first.template get< Type >(), pair.second, tracker);
+    // A few slices a thread, so uneven ones even out
+    static std::vector< Slice > slice(const Internal &data, const size_t width) {
+        const auto sizes = std::apply([](const auto &...pairs) {
+            return std::array< size_t, PackCount >{ pairs.second.size()... };
+        }, data);
+        size_t total = 0;
+        for (const size_t size : sizes) {
+            total += size;
         }
-    };
-
-    template< typename ...Types >
-    static void writeBack(std::pair< Packs< Types... >, IDMap > &pair, Tracker &tracker) {
-        using extract = WriteExtractor< Types... >;
-        (..., extract::template wb< Types >(pair, tracker));
+        const size_t grain = std::max(PARALLEL_GRAIN, (total + 4 * width - 1) / (4 * width));
+        std::vector< Slice > slices;
+        for (size_t pack = 0; pack < PackCount; ++pack) {
+            for (size_t first = 0; first < sizes[pack]; first += grain) {
+                slices.push_back(Slice{ pack, first, std::min(first + grain, sizes[pack]) });
+            }
+        }
+        return slices;
     }
 
     static void run(Tracker &tracker, const Func &f) {
-        const auto start = std::chrono::high_resolution_clock::now();
-        using Internal = std::tuple< std::pair< MainPack, IDMap >, std::pair< Packss, IDMap > ... >;
-        using External = std::tuple< std::pair< MainPack, const IDMap >, std::pair< Packss, const IDMap > ... >;
         Internal data;
-        using FI = FindIndices< MainPack, std::pair< Packss, IDMap > ... >;
-        std::set< EntityID > ids;
-        tracker.withReadLock([&]() {
-            getIndices(std::get< 0 >(data), tracker, ids);
-            (..., populate(std::get< FI::template index< std::pair< Packss, IDMap > >() >(data), tracker, ids));
-            populateMain(std::get< 0 >(data), tracker, ids);
-        });
+        gather(tracker, data);
+        // Only the id views differ in constness
         External &edata = reinterpret_cast< External & >(data);
-        const auto funcStart = std::chrono::high_resolution_clock::now();
+        const auto start = std::chrono::high_resolution_clock::now();
         std::apply(f, edata);
-        const auto funcStop = std::chrono::high_resolution_clock::now();
-        tracker.withWriteLock([&](){
-            writeBack(std::get< 0 >(data), tracker);
-            (..., writeBack(std::get< FI::template index< std::pair< Packss, IDMap > >() >(data), tracker));
-        });
-        const auto stop = std::chrono::high_resolution_clock::now();
-        const auto duration = (stop - start) - (funcStop - funcStart);
-        addEntityTime(duration);
+        addQueryTime(std::chrono::high_resolution_clock::now() - start);
+    }
+
+    // Like run, but the rows are split into slices run across the system pool
+    // Every task sees all of each pack, and gets its own Acc to reduce into
+    // Returns the tasks' accumulators in row order, for the caller to combine
+    template< typename Acc >
+    static std::vector< Acc > parallel(Tracker &tracker, SystemManager &systems, const ParallelFunc< Acc > &f) {
+        Internal data;
+        gather(tracker, data);
+        const std::vector< Slice > slices = slice(data, parallelWidth(systems));
+        std::vector< Acc > accs(slices.size());
+        std::vector< std::function< void() > > tasks;
+        tasks.reserve(slices.size());
+        for (size_t i = 0; i < slices.size(); ++i) {
+            tasks.emplace_back([&, i]() {
+                Trace::Span span("Slice");
+                // Tasks share the gathered views, they only read them
+                External &edata = reinterpret_cast< External & >(data);
+                std::apply([&](auto &...pairs) { f(pairs..., slices[i], accs[i]); }, edata);
+            });
+        }
+        const auto start = std::chrono::high_resolution_clock::now();
+        runParallel(systems, tasks);
+        addQueryTime(std::chrono::high_resolution_clock::now() - start);
+        return accs;
     }
 };
 
 template< typename ...Types >
 struct ExecSimple {
-    using Func = std::function< void(const IDMap &, ConstLifted< std::vector, Types > &...) >;
+    using Func = std::function< void(const IDMap &, typename ConstyContainer< Types >::Type &...) >;
+    template< typename Acc >
+    using ParallelFunc = std::function< void(const IDMap &, typename ConstyContainer< Types >::Type &..., const Slice &, Acc &) >;
+    using Pack = Packs< Types... >;
+    using Executor = Exec< Pack >;
+
+    static ConstySignature access() {
+        return Executor::access();
+    }
+
     static void run(Tracker &tracker, const Func &f) {
-        using Pack = Packs< Types... >;
-        using Executor = Exec< Pack >;
         Executor::run(tracker, [&](std::pair< Pack, const IDMap > &pack) {
-            std::apply(std::bind_front(f, pack.second), pack.first.data);
+            std::apply([&](auto &...views) { f(pack.second, views...); }, pack.first.data);
+        });
+    }
+
+    template< typename Acc >
+    static std::vector< Acc > parallel(Tracker &tracker, SystemManager &systems, const ParallelFunc< Acc > &f) {
+        return Executor::template parallel< Acc >(tracker, systems,
+        [&](std::pair< Pack, const IDMap > &pack, const Slice &slice, Acc &acc) {
+            std::apply([&](auto &...views) { f(pack.second, views..., slice, acc); }, pack.first.data);
         });
     }
 };
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Entity {
+
+// One entity's instances of a multi type, a span into its column's flat storage
+// Constness is deep like a vector's, a const Multi only hands out const instances
+// Like a View it's only valid until the tick's structural changes are applied
+template< typename T >
+class Multi {
+    T *items;
+    size_t count;
+
+    public:
+        typedef T value_type;
+
+        Multi(): items(nullptr), count(0) { }
+        Multi(T *items, const size_t count): items(items), count(count) { }
+
+        size_t size() const { return count; }
+        bool empty() const { return 0 == count; }
+
+        T &operator[](const size_t i) { return items[i]; }
+        const T &operator[](const size_t i) const { return items[i]; }
+
+        T *begin() { return items; }
+        T *end() { return items + count; }
+        const T *begin() const { return items; }
+        const T *end() const { return items + count; }
+};
+
+}
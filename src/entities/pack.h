@@ -38,10 +38,18 @@ struct Pack {
     }
 };
 
+// Views straight into the chunk columns, const types only hand out const rows
 template< typename ...Args >
 struct Packs {
-    std::tuple< typename ConstyContainer< Args >::Type ... > data;
-    using Mutable = typename std::tuple< typename ConstyContainer< Args >::Type ... >;
+    std::tuple< std::remove_const_t< typename ConstyContainer< Args >::Type > ... > data;
+
+    static Signature signature() {
+        return getSignature< Args... >();
+    }
+
+    static ConstySignature access() {
+        return getConstySignature< Args... >();
+    }
 
     template< typename T >
     typename std::enable_if< !std::is_const< T >::value, typename DataStorageType< T >::Container >::type
@@ -51,7 +59,7 @@ struct Packs {
     }
 
     template< typename T >
-    const DataStorageType< std::remove_const_t< T > >::Container &get() const {
+    const std::tuple_element_t< PackAccess< 0, T, Args... >::type::index, decltype(data) > &get() const {
         constexpr size_t i = PackAccess< 0, T, Args... >::type::index;
         return std::get< i >(data);
     }
@@ -4,12 +4,14 @@
 #include "core/core.h"
 
 #include <sstream>
+#include <mutex>
+#include <map>
 
 namespace {
 
-bool typeLessThan(const Entity::TypeID left, const Entity::TypeID right) {
-    return left < right;
-}
+std::mutex k_type_tex;
+std::vector< Entity::TypeID > k_index_types;
+std::map< Entity::TypeID, size_t > k_type_indices;
 
 }
 
@@ -17,22 +19,41 @@ std::ostream &operator<<(std::ostream &os, const Entity::TypeID &tid) {
     return (os << tid.name());
 }
 
-std::ostream &operator<<(std::ostream &os, const Entity::Signature &sig) {
+std::ostream &operator<<(std::ostream &os, const Entity::OrderedSignature &sig) {
     return dumpContainer(os, sig);
 }
 
-std::ostream &operator<<(std::ostream &os, const Entity::ConstySignature &sig) {
-    return dumpContainer(os, sig);
+namespace Entity {
+
+std::ostream &operator<<(std::ostream &os, const Signature &sig) {
+    os << '(' << sig.size() << ")[ ";
+    for (const TypeID tid : sig) {
+        os << tid.name() << ' ';
+    }
+    return (os << ']');
 }
 
-std::ostream &operator<<(std::ostream &os, const Entity::OrderedSignature &sig) {
-    return dumpContainer(os, sig);
+std::ostream &operator<<(std::ostream &os, const ConstySignature &sig) {
+    return (os << "reads " << sig.reads << " writes " << sig.writes);
 }
 
-namespace Entity {
+size_t registerTypeIndex(const TypeID tid) {
+    std::lock_guard< std::mutex > lock(k_type_tex);
+    const auto loc = k_type_indices.find(tid);
+    if (k_type_indices.end() != loc) { return loc->second; }
+    const size_t index = k_index_types.size();
+    k_index_types.push_back(tid);
+    k_type_indices.emplace(tid, index);
+    return index;
+}
+
+TypeID typeForIndex(const size_t index) {
+    std::lock_guard< std::mutex > lock(k_type_tex);
+    return k_index_types.at(index);
+}
 
 bool typesSubset(const Entity::Signature &super, const Entity::Signature &sub) {
-    return std::includes(super.begin(), super.end(), sub.begin(), sub.end(), typeLessThan); // TODO: Speedup
+    return super.includes(sub);
 }
 
 std::string signatureString(const Entity::Signature &sig) {
@@ -49,7 +70,7 @@ std::string signatureString(const Entity::ConstySignature &sig) {
 
 std::string signatureString(const Entity::OrderedSignature &sig) {
     std::stringstream ss;
-    ss << sig;
+    ::operator<<(ss, sig);
     return ss.str();
 }
 
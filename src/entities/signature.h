@@ -2,14 +2,19 @@
 
 #include <ctti/type_id.hpp>
 #include <string_view>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <iterator>
 #include <vector>
+#include <array>
 #include <utility>
-#include <set>
+#include <bit>
 
 namespace Entity {
 
 typedef ctti::type_id_t TypeID;
-typedef std::pair< bool, TypeID > ConstyTypeID;
 
 }
 
@@ -31,15 +36,199 @@ constexpr bool operator<(const ctti::type_id_t &left, const ctti::type_id_t &rig
 
 namespace Entity {
 
-typedef std::set< TypeID > Signature;
-typedef std::set< ConstyTypeID > ConstySignature;
+// Each component type gets a small dense index the first time it's used,
+//      either by addSource or by a signature naming it
+size_t registerTypeIndex(const TypeID tid);
+TypeID typeForIndex(const size_t index);
+
+// Set of component types as a bitset over their dense indices
+// The first 128 types live inline, the rest in an overflow that's kept trimmed
+class Signature {
+    public:
+        static constexpr size_t WORD_BITS = 64;
+        static constexpr size_t INLINE_WORDS = 2;
+
+        class iterator {
+            const Signature *sig;
+            size_t index;
+
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef TypeID value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const TypeID *pointer;
+                typedef TypeID reference;
+
+                iterator(const Signature *sig, size_t index): sig(sig), index(index) { }
+                TypeID operator*() const { return typeForIndex(index); }
+                size_t typeIndex() const { return index; }
+                iterator &operator++() {
+                    index = sig->nextIndex(index + 1);
+                    return *this;
+                }
+                bool operator==(const iterator &other) const { return index == other.index; }
+                bool operator!=(const iterator &other) const { return index != other.index; }
+        };
+
+    private:
+        std::array< uint64_t, INLINE_WORDS > words = {};
+        std::vector< uint64_t > overflow;
+
+        size_t wordCount() const {
+            return INLINE_WORDS + overflow.size();
+        }
+
+        uint64_t word(const size_t w) const {
+            if (w < INLINE_WORDS) { return words[w]; }
+            return (w - INLINE_WORDS < overflow.size()) ? overflow[w - INLINE_WORDS] : 0;
+        }
+
+        uint64_t &wordRef(const size_t w) {
+            if (w < INLINE_WORDS) { return words[w]; }
+            if (w - INLINE_WORDS >= overflow.size()) { overflow.resize(w - INLINE_WORDS + 1, 0); }
+            return overflow[w - INLINE_WORDS];
+        }
+
+        void trim() {
+            while (!overflow.empty() && 0 == overflow.back()) { overflow.pop_back(); }
+        }
+
+    public:
+        typedef TypeID value_type;
+        typedef iterator const_iterator;
+
+        Signature() { }
+
+        template< typename It >
+        Signature(It first, It last) {
+            for (; first != last; ++first) { insert(*first); }
+        }
+
+        Signature(std::initializer_list< TypeID > tids): Signature(tids.begin(), tids.end()) { }
+
+        bool test(const size_t index) const {
+            return (word(index / WORD_BITS) >> (index % WORD_BITS)) & 1;
+        }
+
+        // Returns whether the type was newly added
+        bool set(const size_t index) {
+            uint64_t &w = wordRef(index / WORD_BITS);
+            const uint64_t bit = uint64_t(1) << (index % WORD_BITS);
+            const bool added = !(w & bit);
+            w |= bit;
+            return added;
+        }
+
+        // Returns how many types were removed
+        size_t reset(const size_t index) {
+            if (index / WORD_BITS >= wordCount()) { return 0; }
+            uint64_t &w = wordRef(index / WORD_BITS);
+            const uint64_t bit = uint64_t(1) << (index % WORD_BITS);
+            const size_t removed = (w & bit) ? 1 : 0;
+            w &= ~bit;
+            trim();
+            return removed;
+        }
+
+        bool insert(const TypeID tid) { return set(registerTypeIndex(tid)); }
+        size_t erase(const TypeID tid) { return reset(registerTypeIndex(tid)); }
+        size_t count(const TypeID tid) const { return test(registerTypeIndex(tid)) ? 1 : 0; }
+
+        // First set index at or after from, or npos
+        size_t nextIndex(const size_t from) const {
+            for (size_t w = from / WORD_BITS; w < wordCount(); ++w) {
+                uint64_t bits = word(w);
+                if (w == from / WORD_BITS) { bits &= ~uint64_t(0) << (from % WORD_BITS); }
+                if (bits) { return w * WORD_BITS + std::countr_zero(bits); }
+            }
+            return npos;
+        }
+
+        static constexpr size_t npos = std::numeric_limits< size_t >::max();
+
+        iterator begin() const { return iterator(this, nextIndex(0)); }
+        iterator end() const { return iterator(this, npos); }
+
+        size_t size() const {
+            size_t total = 0;
+            for (size_t w = 0; w < wordCount(); ++w) { total += std::popcount(word(w)); }
+            return total;
+        }
+
+        bool empty() const {
+            for (size_t w = 0; w < wordCount(); ++w) {
+                if (word(w)) { return false; }
+            }
+            return true;
+        }
+
+        // Whether every type in sub is also in this
+        bool includes(const Signature &sub) const {
+            for (size_t w = 0; w < sub.wordCount(); ++w) {
+                if (sub.word(w) & ~word(w)) { return false; }
+            }
+            return true;
+        }
+
+        bool intersects(const Signature &other) const {
+            const size_t words = std::min(wordCount(), other.wordCount());
+            for (size_t w = 0; w < words; ++w) {
+                if (word(w) & other.word(w)) { return true; }
+            }
+            return false;
+        }
+
+        Signature &operator|=(const Signature &other) {
+            for (size_t w = 0; w < other.wordCount(); ++w) {
+                if (other.word(w)) { wordRef(w) |= other.word(w); }
+            }
+            return *this;
+        }
+
+        size_t hash() const {
+            size_t h = 0;
+            for (size_t w = 0; w < wordCount(); ++w) {
+                h ^= std::hash< uint64_t >()(word(w)) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            }
+            return h;
+        }
+
+        bool operator==(const Signature &other) const {
+            return words == other.words && overflow == other.overflow;
+        }
+
+        bool operator!=(const Signature &other) const {
+            return !(*this == other);
+        }
+};
+
+// What a system reads and writes, const types are only read
+struct ConstySignature {
+    Signature reads;
+    Signature writes;
+
+    // Whether running alongside other could race
+    bool conflicts(const ConstySignature &other) const {
+        return writes.intersects(other.writes)
+            || writes.intersects(other.reads)
+            || reads.intersects(other.writes);
+    }
+
+    ConstySignature &operator|=(const ConstySignature &other) {
+        reads |= other.reads;
+        writes |= other.writes;
+        return *this;
+    }
+};
+
 typedef std::vector< TypeID > OrderedSignature;
 
+std::ostream &operator<<(std::ostream &os, const Signature &sig);
+std::ostream &operator<<(std::ostream &os, const ConstySignature &sig);
+
 }
 
 std::ostream &operator<<(std::ostream &os, const Entity::TypeID &tid);
-std::ostream &operator<<(std::ostream &os, const Entity::Signature &sig);
-std::ostream &operator<<(std::ostream &os, const Entity::ConstySignature &sig);
 std::ostream &operator<<(std::ostream &os, const Entity::OrderedSignature &sig);
 
 template<>
@@ -52,25 +241,7 @@ bool operator()(const Entity::TypeID &left, const Entity::TypeID &right) const {
 template<>
 struct std::hash< Entity::Signature > {
     std::size_t operator()(const Entity::Signature &sig) const {
-        size_t h = 0;
-        for (const Entity::Signature::value_type &v : sig) {
-            h ^= hash< Entity::Signature::value_type >()(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
-        }
-        return h;
-    }
-};
-
-template<>
-struct std::less< Entity::Signature > {
-    bool operator()(const Entity::Signature &l, const Entity::Signature &r) const {
-        if (l.size() != r.size()) { return l.size() < r.size(); }
-        for (auto li = l.cbegin(), ri = r.cbegin();
-             li != l.cend(); ++li, ++ri) {
-            if (*li != *ri) {
-                return ::operator<(*li, *ri);
-            }
-        }
-        return false;
+        return sig.hash();
     }
 };
 
@@ -81,6 +252,12 @@ constexpr TypeID DataTypeID() {
     return ctti::type_id< std::remove_const_t< T > >();
 }
 
+template< typename T >
+size_t DataTypeIndex() {
+    static const size_t index = registerTypeIndex(DataTypeID< T >());
+    return index;
+}
+
 template< typename T >
 constexpr ctti::detail::cstring DataTypeName() {
     return ctti::nameof< std::remove_const_t< T > >();
@@ -91,11 +268,11 @@ struct SetSignature;
 template< typename T, typename ...Rest >
 struct SetSignature< T, Rest... > {
     static inline void set(Signature &sig) {
-        sig.insert(DataTypeID< T >());
+        sig.set(DataTypeIndex< T >());
         SetSignature< Rest... >::set(sig);
     }
     static inline void set(ConstySignature &sig) {
-        sig.insert(std::make_pair(std::is_const< T >::value, DataTypeID< T >()));
+        (std::is_const< T >::value ? sig.reads : sig.writes).set(DataTypeIndex< T >());
         SetSignature< Rest... >::set(sig);
     }
     static inline void set(OrderedSignature &sig) {
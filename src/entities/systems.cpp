@@ -1,8 +1,11 @@
 #include "entities/systems.h"
 
 #include "core/core.h"
+#include "utility/trace.h"
 
 #include <functional>
+#include <algorithm>
+#include <numeric>
 #include <iostream>
 #include <tuple>
 #include <coz.h>
@@ -14,138 +17,235 @@ namespace Entity {
 
     void BaseSystem::init(Core &)  { }
 
-    void SystemManager::threadJob() {
-        while (true) {
-            std::function< void() > func;
-            {
-                std::unique_lock< std::mutex > lk(tex);
-                cv.wait(lk, [this]{ return terminating || !work_queue.empty(); });
-                if (terminating) { return; }
-                func = work_queue.front();
-                work_queue.pop();
-            }
-            COZ_BEGIN("SYSTEM");
-            func();
-            COZ_END("SYSTEM");
-            {
-                std::lock_guard< std::mutex > lock(tex);
-                processed += 1;
-                // Can we do better than this?
-                cv.notify_all();
-            }
-        }
+    SystemManager::SystemManager(boost::program_options::variables_map &options)
+        : replan_every(options.count("replan") ? options["replan"].as< size_t >() : 0)
+        , thread_count(options["j"].as< size_t >()) {
     }
 
-    SystemManager::SystemManager(boost::program_options::variables_map &options) {
-        terminating = false;
-        threads.resize(options["j"].as< size_t >());
-    }
-
-    SystemManager::~SystemManager() {
-        {
-            std::unique_lock lock(tex);
-            terminating = true;
-            cv.notify_all();
-        }
-        for (auto &t : threads) {
-            t.join();
-        }
-    }
+    SystemManager::~SystemManager() { }
 
     void SystemManager::addSystem(std::unique_ptr< BaseSystem > system) {
-        system_timers[system.get()] = AccumulateTimer();
         systems.push_back(std::move(system));
     }
 
     void SystemManager::execute(Core &core, double seconds) {
         overhead.add([&](){
-            for (size_t i = 0; i < stages.size(); ++i) {
-                auto &stage = stages[i];
-                {
-                    std::lock_guard< std::mutex > lock(tex);
-                    for (auto *system : stage) {
-                        [this, &core, seconds](BaseSystem *system) {
-                            work_queue.push([this, &core, seconds, system]() {
-                                system_timers[system].add([&](){
-                                    system->execute(core, seconds);
-                                });
-                            });
-                        }(system);
-                    }
-                    processed = 0;
-                }
+            if (0 != replan_every && unplanned_ticks >= replan_every) {
+                Trace::Span span("Replan");
+                replan();
+            }
+            ++unplanned_ticks;
 
-                std::unique_lock< std::mutex > lock(tex);
-                stage_timers[i].add([&](){
-                    cv.notify_all();
-                    cv.wait(lock, [&]{ return stage.size() == processed; });
-                });
+            tick_core = &core;
+            tick_seconds = seconds;
+            // Before anything runs, so each system's ids are taken in the same order every tick
+            for (auto &node : nodes) {
+                node->buffer.refill(core.tracker);
             }
+            core.tracker.openLanes(nodes.size());
+            graph_time.add([&](){
+                Trace::Span span("Systems");
+                remaining = nodes.size();
+                for (auto &node : nodes) {
+                    node->pending = node->predecessors.size();
+                }
+                for (const size_t root : roots) {
+                    makeReady(root);
+                }
+                pool.wait(remaining);
+            });
+            core.tracker.closeLanes();
 
-            reaping_time.add([&](){
-                core.tracker.finalizeKills(core);
+            // Registration order, so the outcome doesn't depend on which thread ran what
+            playback_time.add([&](){
+                Trace::Span span("Playback");
+                for (auto &node : nodes) {
+                    node->buffer.playback(core, core.tracker);
+                }
             });
+
+            reaping_latency.add(reaping_time.add([&](){
+                Trace::Span span("Reaping");
+                core.tracker.finalizeKills(core);
+            }));
         });
     }
 
+    bool SystemManager::startsAfter(const size_t l, const size_t r) const {
+        if (nodes[l]->rank != nodes[r]->rank) {
+            return nodes[l]->rank < nodes[r]->rank;
+        }
+        return l > r;
+    }
+
+    void SystemManager::makeReady(const size_t node) {
+        {
+            std::lock_guard< std::mutex > lock(ready_tex);
+            ready.push_back(node);
+            std::push_heap(ready.begin(), ready.end(), [this](const size_t l, const size_t r) { return startsAfter(l, r); });
+        }
+        pool.push(dispatch, remaining);
+    }
+
+    void SystemManager::replan() {
+        for (auto &node : nodes) {
+            node->cost = node->spent.count() / unplanned_ticks;
+            node->spent = std::chrono::duration< double >(0);
+        }
+        unplanned_ticks = 0;
+
+        // Edges only point forward, so ranks fill in backwards
+        for (size_t i = nodes.size(); i-- > 0;) {
+            double after = 0.0;
+            for (const size_t next : nodes[i]->successors) {
+                after = std::max(after, nodes[next]->rank);
+            }
+            nodes[i]->rank = nodes[i]->cost + after;
+        }
+        const auto lower = [this](const size_t l, const size_t r) { return startsAfter(l, r); };
+
+        // Predict the tick by running the plan on paper, a free thread taking the highest ranked ready system
+        // That's what dispatch does, so it holds however the pool hands out the jobs
+        const size_t width = pool.width();
+        std::vector< size_t > pending(nodes.size());
+        std::vector< size_t > startable(roots.begin(), roots.end());
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            pending[i] = nodes[i]->predecessors.size();
+        }
+        typedef std::pair< double, size_t > Running; // Finish time, system
+        std::vector< Running > running;
+        const auto later = [](const Running &l, const Running &r) { return l.first > r.first; };
+        double now = 0.0;
+        double serial = 0.0;
+        while (!startable.empty() || !running.empty()) {
+            std::sort(startable.begin(), startable.end(), lower);
+            while (!startable.empty() && running.size() < width) {
+                const size_t next = startable.back();
+                startable.pop_back();
+                running.emplace_back(now + nodes[next]->cost, next);
+                std::push_heap(running.begin(), running.end(), later);
+                serial += nodes[next]->cost;
+            }
+            std::pop_heap(running.begin(), running.end(), later);
+            const Running done = running.back();
+            running.pop_back();
+            now = done.first;
+            for (const size_t next : nodes[done.second]->successors) {
+                if (0 == --pending[next]) {
+                    startable.push_back(next);
+                }
+            }
+        }
+
+        std::vector< size_t > order(nodes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](const size_t l, const size_t r) { return lower(r, l); });
+        double critical = 0.0;
+        for (const size_t root : roots) {
+            critical = std::max(critical, nodes[root]->rank);
+        }
+        std::cout << "Plan for " << width << " threads, by rank (ms to the end of the graph):\n";
+        for (const size_t i : order) {
+            std::cout << "\t" << nodes[i]->rank * 1000.0 << " " << nodes[i]->system->name
+                      << " (" << nodes[i]->cost * 1000.0 << ")\n";
+        }
+        std::cout << "\tPredicted tick: " << now * 1000.0 << "ms, critical path " << critical * 1000.0 << "ms, "
+                  << ((now > 0.0) ? serial / now : 1.0) << "x over serial\n";
+        std::cout.flush();
+    }
+
+    void SystemManager::runTasks(const std::vector< std::function< void() > > &tasks) {
+        pool.run(tasks);
+    }
+
+    size_t SystemManager::width() const {
+        return pool.width();
+    }
+
     void SystemManager::init(Core &core) {
-        std::vector< BaseSystem* > pile;
         for (auto &s : systems) {
             s->init(core);
-            pile.push_back(s.get());
-        }
-
-        while (!pile.empty()) {
-            std::vector< BaseSystem* > notfit;
-            stages.resize(stages.size() + 1);
-            stage_timers.resize(stages.size());
-            std::set< ConstyTypeID > types;
-
-            for (size_t i = 0; i < pile.size(); ++i) {
-                const auto sig = pile[i]->signature;
-                // Does this stage already operate on these types?
-                bool conflict = false;
-                for (ConstyTypeID tid : sig) {
-                    for (const auto &other : types) {
-                        if (other.second != tid.second) { continue; }
-                        if (other.first && tid.first) { continue; }
-                        conflict = true;
-                        break;
-                    }
-                }
+        }
+
+        ready.reserve(systems.size());
+        dispatch = [this]() {
+            size_t next;
+            {
+                std::lock_guard< std::mutex > lock(ready_tex);
+                std::pop_heap(ready.begin(), ready.end(), [this](const size_t l, const size_t r) { return startsAfter(l, r); });
+                next = ready.back();
+                ready.pop_back();
+            }
+            nodes[next]->task();
+        };
 
-                if (conflict) { // This needs to be dealt with in some later stage
-                    notfit.push_back(pile[i]);
-                } else { // Add this to this stage
-                    for (ConstyTypeID tid : sig) {
-                        types.insert(tid);
+        for (size_t i = 0; i < systems.size(); ++i) {
+            nodes.push_back(std::make_unique< Node >());
+            Node &node = *nodes.back();
+            node.system = systems[i].get();
+            node.buffer.setLane(i);
+            std::seed_seq seeds{ randomSeed(), uint64_t(i) };
+            node.random.seed(seeds);
+            // Touching the same types as an earlier system means waiting for it
+            for (size_t j = 0; j < i; ++j) {
+                if (nodes[j]->system->signature.conflicts(node.system->signature)) {
+                    node.predecessors.push_back(j);
+                    nodes[j]->successors.push_back(i);
+                }
+            }
+            node.task = [this, &node]() {
+                CommandBuffer::Scope scope(&node.buffer);
+                AccessScope access(node.system);
+                RandomScope stream(node.random);
+                Trace::Span span(node.system->name.c_str());
+                COZ_BEGIN("SYSTEM");
+                const auto time = node.timer.add([&](){
+                    node.system->execute(*tick_core, tick_seconds);
+                });
+                node.spent += time;
+                node.latency.add(time);
+                COZ_END("SYSTEM");
+                // Queued before this job counts as done, so the tick can't end early
+                for (const size_t next : node.successors) {
+                    if (1 == nodes[next]->pending.fetch_sub(1)) {
+                        makeReady(next);
                     }
-                    stages[stages.size() - 1].push_back(pile[i]);
                 }
+            };
+
+            if (node.predecessors.empty()) {
+                roots.push_back(i);
             }
 
-            pile = std::move(notfit);
             if (core.options.count("verbose")) {
-                std::cout << "Stage " << stages.size() << ":\n";
-                for (auto sys : stages[stages.size() - 1]) {
-                    std::cout << '\t' << sys->name << ": " << signatureString(sys->signature) << '\n';
+                std::cout << node.system->name << ": " << signatureString(node.system->signature) << '\n';
+                for (const size_t j : node.predecessors) {
+                    std::cout << "\tAfter " << nodes[j]->system->name << '\n';
                 }
             }
         }
 
-        if (0 == threads.size()) {
+        if (0 == thread_count) {
+            // Systems at the same depth of the graph can all run at once
+            std::vector< size_t > depths(nodes.size(), 0);
+            std::vector< size_t > level;
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                for (const size_t j : nodes[i]->predecessors) {
+                    depths[i] = std::max(depths[i], depths[j] + 1);
+                }
+                if (depths[i] >= level.size()) { level.resize(depths[i] + 1, 0); }
+                ++level[depths[i]];
+            }
             const size_t max = std::thread::hardware_concurrency();
             size_t width = 0;
-            for (auto &stage : stages) {
-                width = std::max(width, stage.size());
+            for (const size_t count : level) {
+                width = std::max(width, count);
             }
-            const size_t actual = std::min(width, max);
-            threads.resize(actual);
-            std::cout << "Using " << actual << " threads\n";
-        }
-        for (size_t i = 0; i < threads.size(); ++i) {
-            threads[i] = std::thread([this](){ threadJob(); });
+            thread_count = std::max(size_t(1), std::min(width, max));
+            std::cout << "Using " << thread_count << " threads\n";
         }
+        // The thread running the graph works too
+        pool.start(thread_count - 1);
     }
 
     void SystemManager::dumpTimes() {
@@ -153,45 +253,44 @@ namespace Entity {
         typedef std::vector< Stat > Stats;
         typedef std::tuple< double, std::string, Stats, double > StatGroup;
         std::vector< StatGroup > statgroups;
-        statgroups.reserve(systems.size() + 1);
+        statgroups.reserve(2);
 
-        double stage_times = 0.0;
-        double all_stage_system_times = 0.0;
-        for (size_t i = 0; i < stages.size(); ++i) {
+        std::vector< double > times;
+        times.reserve(nodes.size());
+        double systems_time = 0.0;
+        const double graph = graph_time.empty();
+        {
             Stats stats;
-            double systems_time = 0.0;
-            const auto &stage = stages[i];
-            for (const auto *system : stage) {
-                auto &timer = system_timers[system];
-                std::string text = system->name + ": " + signatureString(system->signature);
-                const double system_time = timer.empty();
-                stats.emplace_back( system_time, text );
+            for (auto &node : nodes) {
+                const double system_time = node->timer.empty();
+                times.push_back(system_time);
+                stats.emplace_back(system_time, node->system->name + ": " + signatureString(node->system->signature));
                 systems_time += system_time;
-                all_stage_system_times += system_time;
             }
-            const double stage_time = stage_timers[i].empty();
-            stage_times += stage_time;
 
             std::sort(stats.begin(), stats.end(), [](const Stat &l, const Stat &r) -> bool {
                 return std::get< 0 >(l) > std::get< 0 >(r);
             });
 
             double parallelism = 1.0;
-            if (stage_time > 0) {
-                parallelism = systems_time / stage_time;
+            if (graph > 0) {
+                parallelism = systems_time / graph;
             }
 
-            statgroups.emplace_back(stage_time, "Stage " + std::to_string(i + 1), stats, parallelism);
+            statgroups.emplace_back(graph, "Systems", stats, parallelism);
         }
 
         {
             Stats stats;
             const double reaping = reaping_time.empty();
             stats.emplace_back(reaping, "Reaping");
+            const double playback = playback_time.empty();
+            stats.emplace_back(playback, "Playback");
 
             double overhead_time = overhead.empty();
             overhead_time -= reaping;
-            overhead_time -= stage_times;
+            overhead_time -= playback;
+            overhead_time -= graph;
             stats.emplace_back(overhead_time, "System Manager");
 
             double admin = 0.0;
@@ -209,8 +308,35 @@ namespace Entity {
             return std::get< 0 >(l) > std::get< 0 >(r);
         });
 
-        const double parallelism = (stage_times > 0.0) ? all_stage_system_times / stage_times : 1.0;
+        // Longest chain of dependent systems by time, no amount of threads gets the tick under it
+        // Edges only point forward, so registration order is already topological
+        std::vector< double > longest(nodes.size(), 0.0);
+        std::vector< size_t > via(nodes.size(), nodes.size());
+        size_t last = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            for (const size_t j : nodes[i]->predecessors) {
+                if (longest[j] > longest[i]) {
+                    longest[i] = longest[j];
+                    via[i] = j;
+                }
+            }
+            longest[i] += times[i];
+            if (longest[i] > longest[last]) { last = i; }
+        }
+        std::vector< std::string > path;
+        for (size_t i = last; i < nodes.size(); i = via[i]) {
+            path.push_back(nodes[i]->system->name);
+        }
+
+        const double parallelism = (graph > 0.0) ? systems_time / graph : 1.0;
         std::cout << "\tParallelism: " << parallelism << '\n';
+        if (!nodes.empty()) {
+            std::cout << "\tCritical path: " << longest[last] << " (";
+            for (auto name = path.rbegin(); name != path.rend(); ++name) {
+                std::cout << ((path.rbegin() == name) ? "" : " -> ") << *name;
+            }
+            std::cout << ")\n";
+        }
         for (const auto &group : statgroups) {
             std::cout << "\t" << std::get< 1 >(group);
             std::cout << ": " << std::get< 0 >(group);
@@ -222,4 +348,16 @@ namespace Entity {
 
         std::cout.flush();
     }
+
+    SystemManager::Latencies SystemManager::latencies() {
+        Latencies lats;
+        lats.reserve(nodes.size() + 3);
+        for (auto &node : nodes) {
+            lats.emplace_back(node->system->name, node->latency.empty());
+        }
+        lats.emplace_back("Reaping", reaping_latency.empty());
+        lats.emplace_back("Query gather", emptyGatherLatency());
+        lats.emplace_back("Query run", emptyQueryLatency());
+        return lats;
+    }
 }  // namespace Entity
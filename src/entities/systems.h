@@ -6,18 +6,19 @@
 #include "entities/pack.h"
 #include "entities/data.h"
 #include "entities/signature.h"
+#include "entities/commands.h"
 #include "utility/timers.h"
+#include "utility/pool.h"
 
 #include <boost/program_options.hpp>
-#include <condition_variable>
 #include <functional>
 #include <utility>
 #include <memory>
 #include <chrono>
 #include <thread>
 #include <vector>
+#include <atomic>
 #include <mutex>
-#include <queue>
 #include <map>
 #include <set>
 
@@ -28,6 +29,8 @@ namespace Entity {
 class BaseSystem {
 public:
     const std::string name;
+    // Everything the system's queries and lookups touch, see Queries
+    // Builds with CHECK_ACCESS assert it doesn't touch anything else
     const ConstySignature signature;
     BaseSystem(const std::string &name, const ConstySignature &sig);
     virtual ~BaseSystem();
@@ -36,22 +39,61 @@ public:
 };
 
 class SystemManager {
+    // A system's place in the dependency graph
+    // It waits on every earlier registered system it conflicts with, and nothing else
+    struct Node {
+        BaseSystem *system;
+        AccumulateTimer timer;
+        HistogramTimer latency;
+        CommandBuffer buffer;
+        Random random;
+        std::vector< size_t > predecessors;
+        std::vector< size_t > successors;
+        // Predecessors yet to finish this tick
+        std::atomic< size_t > pending;
+        std::function< void() > task;
+        // Time spent since the last plan, and the plan's estimate of a tick's worth
+        std::chrono::duration< double > spent{ 0 };
+        double cost = 0.0;
+        // Cost of the longest chain from here to the end of the graph
+        double rank = 0.0;
+    };
+
     AccumulateTimer reaping_time;
+    HistogramTimer reaping_latency;
+    AccumulateTimer playback_time;
+    AccumulateTimer graph_time;
     AccumulateTimer overhead;
-    std::map< const BaseSystem*, AccumulateTimer > system_timers;
-    std::vector< AccumulateTimer > stage_timers;
     std::vector< std::unique_ptr< BaseSystem > > systems;
-    std::vector< std::vector< BaseSystem* > > stages;
+    // In registration order, so every edge points forward
+    std::vector< std::unique_ptr< Node > > nodes;
+
+    // Systems without predecessors
+    std::vector< size_t > roots;
+    // Systems free to start, a heap by rank then registration order
+    // Each one has a dispatch job queued, and whichever thread takes a job runs the best of them,
+    // so the pick doesn't depend on which end of which deque the job came from
+    std::mutex ready_tex;
+    std::vector< size_t > ready;
+    std::function< void() > dispatch;
+    // Whether l should start after r
+    bool startsAfter(const size_t l, const size_t r) const;
+    void makeReady(const size_t node);
 
-    std::vector< std::thread > threads;
-    std::condition_variable cv;
-    bool terminating;
-    std::mutex tex;
+    // What the node tasks run with this tick
+    Core *tick_core = nullptr;
+    double tick_seconds = 0.0;
+    std::atomic< size_t > remaining;
 
-    std::queue< std::function< void() > > work_queue;
-    size_t processed;
+    // Ticks between plans, or 0 to keep registration order
+    const size_t replan_every;
+    size_t unplanned_ticks = 0;
+    // Ranks the systems from their measured costs, so ready ones start longest chain first
+    // The graph's edges don't change, only which ready system a free thread picks up
+    void replan();
 
-    void threadJob();
+    size_t thread_count;
+    WorkPool pool;
 
 public:
     SystemManager(boost::program_options::variables_map &options);
@@ -59,7 +101,16 @@ public:
     void addSystem(std::unique_ptr< BaseSystem > system);
     void execute(Core &core, double seconds);
     void init(Core &core);
+    // Runs tasks on the pool and waits for them all, helping with queued work meanwhile
+    // Safe to call from inside a task, like a system splitting up its rows
+    void runTasks(const std::vector< std::function< void() > > &tasks);
+    // How many threads runTasks can have working at once
+    size_t width() const;
     void dumpTimes();
+
+    typedef std::vector< std::pair< std::string, HistogramTimer::Summary > > Latencies;
+    // Each system's latency since the last call, then reaping's and the queries' phases
+    Latencies latencies();
 };
 
 }
@@ -1,6 +1,9 @@
 #include "entities/tracker.h"
 #include "utility/utility.h"
+#include "entities/systems.h"
+#include "core/core.h"
 
+#include <algorithm>
 #include <sstream>
 
 namespace Entity {
@@ -48,38 +51,220 @@ Signature Tracker::getRegisteredTypes() const {
     return sig;
 }
 
+EntityID Tracker::reserveID() {
+    if (freeSlots.empty()) {
+        slots.emplace_back();
+        return slots.size() - 1;
+    }
+    const uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    return (EntityID(slots[index].generation) << 32) | index;
+}
+
+const Location *Tracker::locate(const EntityID eid) const {
+    const uint32_t index = slotIndex(eid);
+    if (index >= slots.size()) { return nullptr; }
+    const Slot &slot = slots[index];
+    if (slot.generation != slotGeneration(eid) || !slot.location.archetype) { return nullptr; }
+    return &slot.location;
+}
+
+void Tracker::reserveIDs(std::vector< EntityID > &out, const size_t count) {
+    std::unique_lock lock(tex);
+    const size_t start = out.size();
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(reserveID());
+    }
+    // Handed out from the back, so they're given in the order reserved
+    std::reverse(out.begin() + start, out.end());
+}
+
+void Tracker::reserveLaneIDs(std::vector< EntityID > &out, const size_t lane) {
+    std::unique_lock lock(tex);
+    rassert(lane < laneCount, "No lane open", lane, laneCount);
+    const size_t block = laneBlocks[lane]++ * laneCount + lane;
+    const size_t begin = laneBase + block * LANE_BLOCK;
+    if (slots.size() < begin + LANE_BLOCK) { slots.resize(begin + LANE_BLOCK); }
+    if (claimed.size() <= block) { claimed.resize(block + 1, false); }
+    claimed[block] = true;
+    // Handed out from the back, lowest first
+    for (size_t index = begin + LANE_BLOCK; index-- > begin;) {
+        out.push_back((EntityID(slots[index].generation) << 32) | index);
+    }
+}
+
+void Tracker::openLanes(const size_t lanes) {
+    std::unique_lock lock(tex);
+    laneBase = slots.size();
+    laneCount = lanes;
+    laneBlocks.assign(lanes, 0);
+    claimed.clear();
+}
+
+void Tracker::closeLanes() {
+    std::unique_lock lock(tex);
+    for (size_t block = claimed.size(); block-- > 0;) {
+        if (claimed[block]) { continue; }
+        const size_t begin = laneBase + block * LANE_BLOCK;
+        for (size_t index = begin + LANE_BLOCK; index-- > begin;) {
+            freeSlots.push_back(index);
+        }
+    }
+    laneCount = 0;
+    claimed.clear();
+}
+
+void Tracker::releaseIDs(const std::vector< EntityID > &ids) {
+    for (const EntityID id : ids) {
+        freeSlots.push_back(slotIndex(id));
+    }
+}
+
+void Tracker::place(const EntityID eid, const Location &loc) {
+    Slot &slot = slots[slotIndex(eid)];
+    if (!slot.location.archetype) { ++living; }
+    slot.location = loc;
+}
+
+void Tracker::forget(const EntityID eid) {
+    if (!locate(eid)) { return; }
+    const uint32_t index = slotIndex(eid);
+    Slot &slot = slots[index];
+    slot.location = Location{ nullptr, nullptr, 0 };
+    ++slot.generation;
+    freeSlots.push_back(index);
+    --living;
+}
+
+void Tracker::removeRow(const Location &loc) {
+    const EntityID moved = loc.archetype->remove(*loc.chunk, loc.row);
+    if (0 != moved) {
+        place(moved, loc);
+    }
+}
+
+Archetype &Tracker::archetypeFor(Entities &group, const Signature &sig, const bool young) {
+    auto &arch = group[sig];
+    if (!arch) {
+        arch = std::make_unique< Archetype >(sig, young, sources);
+        if (!young) { archetypeList.push_back(arch.get()); }
+    }
+    // Callers only ask for nursery archetypes to add rows to them
+    if (young && 0 == arch->count()) { youngsters.push_back(arch.get()); }
+    return *arch;
+}
+
+Query &Tracker::getQuery(const std::type_index &key, std::vector< Signature > (*signatures)()) {
+    std::lock_guard< std::mutex > lock(queryTex);
+    auto &query = queries[key];
+    if (!query) {
+        query = std::make_unique< Query >();
+        query->signatures = signatures();
+        query->matches.resize(query->signatures.size());
+    }
+    return *query;
+}
+
+void Tracker::updateQuery(Query &query) const {
+    // Each archetype belongs to the first of the later packs it satisfies,
+    //      or to the main pack if it satisfies none of them
+    for (; query.seen < archetypeList.size(); ++query.seen) {
+        Archetype *arch = archetypeList[query.seen];
+        if (!typesSubset(arch->signature, query.signatures[0])) { continue; }
+        size_t which = 0;
+        for (size_t i = 1; i < query.signatures.size(); ++i) {
+            if (typesSubset(arch->signature, query.signatures[i])) {
+                which = i;
+                break;
+            }
+        }
+        query.matches[which].push_back(arch);
+    }
+}
+
 void Tracker::killEntity(Core &, const EntityID id) {
+    if (CommandBuffer *buffer = CommandBuffer::current()) {
+        buffer->record([this, id](Core &) { doomed.insert(id); });
+        return;
+    }
     std::unique_lock lock(tex);
     doomed.insert(id);
 }
 
 void Tracker::finalizeKills(Core &core) {
-    const auto killGroup = [&](Entities &ents, Sources &srcs) {
-        for (auto &pair : ents) {
-            auto &ids = pair.second;
-            for (size_t i = 0; i < ids.size();) {
-                const EntityID eid = ids[i];
-                if (doomed.end() == doomed.find(eid)) {
-                    ++i;
-                    continue;
-                }
-                const Signature &sig = pair.first;
-                for (const TypeID tid : sig) {
-                    srcs.at(tid)->deleteComponent(core, eid);
-                }
-                for (const TypeID tid : sig) {
-                    srcs.at(tid)->remove(eid);
-                }
-                ids[i] = ids[ids.size() - 1];
-                ids.resize(ids.size() - 1);
-            }
+    deferred.playback(core, *this);
+    if (doomed.empty()) { return; }
+
+    // Rows of one type, across every archetype, for its batched delete hook
+    struct TypeBatch {
+        std::vector< uint64_t > ids;
+        std::vector< BaseColumn * > columns;
+        std::vector< size_t > rows;
+    };
+
+    // Sorted, so hooks see their rows and bodies are destroyed in the same order every run
+    std::vector< EntityID > victims;
+    for (const EntityID eid : doomed) {
+        if (locate(eid)) { victims.push_back(eid); }
+    }
+    doomed.clear();
+    std::sort(victims.begin(), victims.end());
+
+    std::unordered_map< Archetype *, std::vector< Location > > byArchetype;
+    std::vector< TypeBatch > byType;
+    for (const EntityID eid : victims) {
+        const Location *found = locate(eid);
+        byArchetype[found->archetype].push_back(*found);
+        const auto &indices = found->archetype->getTypeIndices();
+        for (size_t col = 0; col < indices.size(); ++col) {
+            if (indices[col] >= byType.size()) { byType.resize(indices[col] + 1); }
+            TypeBatch &batch = byType[indices[col]];
+            batch.ids.push_back(eid);
+            batch.columns.push_back(found->chunk->columns[col].get());
+            batch.rows.push_back(found->row);
+        }
+    }
+
+    const bool parallel = victims.size() >= PARALLEL_REAP;
+    const auto run = [&](const std::vector< std::function< void() > > &tasks) {
+        if (parallel) {
+            core.systems.runTasks(tasks);
+        } else {
+            for (const auto &task : tasks) { task(); }
         }
     };
 
-    killGroup(entities, sources);
-    killGroup(nursery, nurserySources);
+    // Hooks see the rows before anything moves
+    std::vector< std::function< void() > > tasks;
+    for (size_t index = 0; index < byType.size(); ++index) {
+        const TypeBatch &batch = byType[index];
+        if (batch.ids.empty()) { continue; }
+        const BaseData *source = sources.at(typeForIndex(index)).get();
+        tasks.emplace_back([&core, &batch, source]() {
+            source->deleteRows(core, batch.ids, batch.columns, batch.rows);
+        });
+    }
+    run(tasks);
 
-    doomed.clear();
+    // Archetypes compact independently, and moved rows have distinct slots
+    tasks.clear();
+    std::vector< std::vector< std::pair< EntityID, Location > > > moved(byArchetype.size());
+    size_t which = 0;
+    for (auto it = byArchetype.begin(); it != byArchetype.end(); ++it, ++which) {
+        tasks.emplace_back([it, &moved, which]() {
+            it->first->removeRows(it->second, moved[which]);
+        });
+    }
+    run(tasks);
+
+    for (const auto &list : moved) {
+        for (const auto &[eid, loc] : list) {
+            place(eid, loc);
+        }
+    }
+    for (const EntityID eid : victims) {
+        forget(eid);
+    }
 }
 
 void Tracker::killAll(Core &core) {
@@ -91,14 +276,7 @@ void Tracker::killAll(Core &core) {
 
 size_t Tracker::count() const {
     std::shared_lock lock(tex);
-    size_t total = 0;
-    for (const auto &group : entities) {
-        total += group.second.size();
-    }
-    for (const auto &group : nursery) {
-        total += group.second.size();
-    }
-    return total;
+    return living;
 }
 
 bool Tracker::alive(const EntityID &eid) const {
@@ -112,17 +290,7 @@ bool Tracker::zombie(const EntityID &eid) const {
 }
 
 bool Tracker::aliveWithLock(const EntityID &eid) const {
-    for (const auto &pair : entities) {
-        if (pair.second.end() != std::find(pair.second.begin(), pair.second.end(), eid)) {
-            return true;
-        }
-    }
-    for (const auto &pair : nursery) {
-        if (pair.second.end() != std::find(pair.second.begin(), pair.second.end(), eid)) {
-            return true;
-        }
-    }
-    return false;
+    return nullptr != locate(eid);
 }
 
 size_t Tracker::sourceCount() const {
@@ -131,65 +299,52 @@ size_t Tracker::sourceCount() const {
 
 std::pair< Signature, bool > Tracker::getSignature(const EntityID &eid) const {
     std::shared_lock lock(tex);
-    for (const auto &pair : entities) {
-        if (pair.second.end() != std::find(pair.second.begin(), pair.second.end(), eid)) {
-            return std::make_pair(pair.first, true);
-        }
-    }
-    for (const auto &pair : nursery) {
-        if (pair.second.end() != std::find(pair.second.begin(), pair.second.end(), eid)) {
-            return std::make_pair(pair.first, false);
-        }
-    }
-    rassert(false, "Failed to find signature for:", eid);
-    return std::make_pair(Signature(), false);
+    const Location *loc = locate(eid);
+    rassert(loc, "Failed to find signature for:", eid);
+    return std::make_pair(loc->archetype->signature, !loc->archetype->nursery);
 }
 
 EntityID Tracker::createSigned(Core &core, const Signature &sig, size_t count) {
     if (0 == count) { return 0; }
     for (const TypeID tid : sig) { rassert(sources.count(tid), tid, sig); }
 
-    const EntityID id = nextID;
-    nextID += count;
-    auto &v = nursery[sig];
-    v.reserve(v.size() + count);
-    for (size_t i = 0; i < count; ++i) { v.push_back(id + i); }
-    for (const TypeID tid : sig) {
-        auto &v = *nurserySources.at(tid);
-        v.reserve(count);
-        for (size_t i = 0; i < count; ++i) { v.add(id + i); }
+    Archetype &arch = archetypeFor(nursery, sig, true);
+    EntityID first = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const EntityID id = reserveID();
+        const Location loc = arch.append(id);
+        place(id, loc);
+        arch.initComponents(core, loc);
+        if (0 == i) { first = id; }
     }
-    for (const auto tid : sig) {
-        nurserySources[tid]->initComponent(core, id);
-    }
-    return id;
+    return first;
 }
 
 void Tracker::graduate() {
-    std::shared_lock lock(tex);
-    for (auto &[tid, srcPtr] : sources) {
-        srcPtr->graduateFrom(*nurserySources[tid]);
-    }
-
-    for (auto &[sig, list] : nursery) {
-        auto &graduated = entities[sig];
-        graduated.reserve(graduated.size() + list.size());
-        graduated.insert(graduated.end(), list.begin(), list.end());
+    std::unique_lock lock(tex);
+    for (Archetype *young : youngsters) {
+        if (0 == young->count()) { continue; }
+        Archetype &adult = archetypeFor(entities, young->signature, false);
+        const size_t first = adult.splice(*young);
+        for (size_t i = first; i < adult.chunks.size(); ++i) {
+            Chunk &chunk = *adult.chunks[i];
+            for (size_t row = 0; row < chunk.size(); ++row) {
+                place(chunk.ids[row], Location{ &adult, &chunk, row });
+            }
+        }
     }
-    nursery.clear();
+    youngsters.clear();
 }
 
 std::vector< EntityID > Tracker::all() const {
     std::vector< EntityID > out;
     std::shared_lock lock(tex);
-    for (auto &pair : entities) {
-        for (auto &eid : pair.second) {
-            out.push_back(eid);
-        }
-    }
-    for (auto &pair : nursery) {
-        for (auto &eid : pair.second) {
-            out.push_back(eid);
+    out.reserve(living);
+    for (const auto &group : { &entities, &nursery }) {
+        for (const auto &[sig, arch] : *group) {
+            for (const auto &chunk : arch->chunks) {
+                out.insert(out.end(), chunk->ids.begin(), chunk->ids.end());
+            }
         }
     }
     return out;
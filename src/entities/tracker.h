@@ -5,6 +5,7 @@
 #include <set>
 #include <map>
 #include <array>
+#include <tuple>
 #include <mutex>
 #include <string>
 #include <memory>
@@ -13,47 +14,219 @@
 #include <iostream>
 #include <functional>
 #include <shared_mutex>
+#include <typeindex>
 #include <unordered_set>
 #include <unordered_map>
 
 #include "utility/utility.h"
 #include "utility/templates.h"
 #include "entities/pack.h"
+#include "entities/access.h"
+#include "entities/archetype.h"
+#include "entities/commands.h"
 
 struct Core;
 
 namespace Entity {
 
-typedef uint64_t EntityID;
-
 class Tracker {
     public:
         typedef std::vector< EntityID > EntityVec;
-        typedef std::unique_ptr< BaseData > SourcePtr;
-        typedef std::map< TypeID, SourcePtr > Sources;
-        typedef std::unordered_map< Signature, EntityVec > Entities;
+        typedef std::unique_ptr< Archetype > ArchetypePtr;
+        typedef std::unordered_map< Signature, ArchetypePtr > Entities;
 
         Sources sources;
         Entities entities;
-
-        Sources nurserySources;
         Entities nursery;
 
     private:
+        // Kill sets at least this big are reaped on the system pool
+        static constexpr size_t PARALLEL_REAP = 1024;
+
         mutable std::shared_mutex tex;
         std::unordered_set< EntityID > doomed;
-        EntityID nextID = 1;
+        // Changes to graduated entities made outside of systems, played back by finalizeKills
+        CommandBuffer deferred;
+
+        // Nursery archetypes that have had rows added since the last graduation
+        // May repeat, or have since emptied, graduate skips those
+        Archetypes youngsters;
+
+        // Mature archetypes in creation order, queries match against its tail
+        Archetypes archetypeList;
+        std::mutex queryTex;
+        std::unordered_map< std::type_index, std::unique_ptr< Query > > queries;
+
+        // Where each entity's row is, indexed by the low half of its id
+        // The high half is the slot's generation, bumped when the slot is freed,
+        //      so stale ids are caught without searching
+        // Slot 0 is never handed out, so 0 still means no entity
+        struct Slot {
+            Location location{ nullptr, nullptr, 0 }; // No archetype while free
+            uint32_t generation = 0;
+        };
+        std::vector< Slot > slots{ 1 };
+        std::vector< uint32_t > freeSlots;
+        size_t living = 0;
+
+        // While systems run, buffers that run out take blocks of fresh slots from their own lane
+        // Lane k's j-th block sits at a place fixed by k and j alone, so nothing depends on timing
+        static constexpr size_t LANE_BLOCK = 32;
+        size_t laneBase = 0;
+        size_t laneCount = 0;
+        std::vector< size_t > laneBlocks;
+        std::vector< bool > claimed;
+
+        static uint32_t slotIndex(const EntityID eid) { return static_cast< uint32_t >(eid); }
+        static uint32_t slotGeneration(const EntityID eid) { return static_cast< uint32_t >(eid >> 32); }
+
+        friend class CommandBuffer;
+        // Takes a free slot, or grows the table
+        // The id reads as dead until something is placed at it
+        EntityID reserveID();
+        void reserveIDs(std::vector< EntityID > &out, const size_t count);
+        void reserveLaneIDs(std::vector< EntityID > &out, const size_t lane);
+        // Note: Needs the write lock held, and the ids must never have been placed
+        void releaseIDs(const std::vector< EntityID > &ids);
+        const Location *locate(const EntityID eid) const;
+        void place(const EntityID eid, const Location &loc);
+        void forget(const EntityID eid);
+        // Removes a row, keeping the location of whatever moved into its place
+        void removeRow(const Location &loc);
+        Archetype &archetypeFor(Entities &group, const Signature &sig, const bool young);
+
+        template< typename T >
+        void putComponent(const Location &loc, const T &t) {
+            using Base = std::remove_const_t< T >;
+            const size_t col = loc.archetype->column(DataTypeIndex< Base >());
+            loc.chunk->template column< Base >(col).put(loc.row, t);
+        }
+
+        template< typename T >
+        typename DataStorageType< std::remove_const_t< T > >::Single *findComponent(const EntityID &eid) const {
+            using Base = std::remove_const_t< T >;
+            const Location *loc = locate(eid);
+            if (!loc || loc->archetype->nursery) { return nullptr; }
+            const size_t col = loc->archetype->column(DataTypeIndex< Base >());
+            if (Archetype::npos == col) { return nullptr; }
+            return &loc->chunk->template column< Base >(col).data[loc->row];
+        }
+
+        template< typename T >
+        void moveInComponent(Core &core, const EntityID eid, const T &component) {
+            const Location from = *locate(eid);
+            Signature sig = from.archetype->signature;
+            const bool added = sig.set(DataTypeIndex< T >());
+            rassert(added);
+            Archetype &to = archetypeFor(from.archetype->nursery ? nursery : entities, sig, from.archetype->nursery);
+
+            const Location loc = to.adopt(*from.archetype, *from.chunk, from.row);
+            removeRow(from);
+            place(eid, loc);
+            putComponent(loc, component);
+            const size_t col = to.column(DataTypeIndex< T >());
+            loc.chunk->columns[col]->initComponent(core, eid, loc.row);
+        }
+
+        template< typename T >
+        void moveOutComponent(Core &core, const EntityID eid) {
+            const Location from = *locate(eid);
+            Signature sig = from.archetype->signature;
+            const size_t index = DataTypeIndex< T >();
+            const auto res = sig.reset(index);
+            rassert(1 == res);
+            from.chunk->columns[from.archetype->column(index)]->deleteComponent(core, eid, from.row);
+            Archetype &to = archetypeFor(from.archetype->nursery ? nursery : entities, sig, from.archetype->nursery);
+
+            const Location loc = to.adopt(*from.archetype, *from.chunk, from.row);
+            removeRow(from);
+            place(eid, loc);
+        }
+
+        template< typename ...Args >
+        void spawn(Core &core, const EntityID id, const Args &... args) {
+            const OrderedSignature osig = getOrderedSignature< Args... >();
+            const Signature sig = Entity::getSignature< Args... >();
+            for (const auto tid : getDuplicates(osig)) {
+                rassert(sources.end() != sources.find(tid), "Missing type used!", osig);
+                rassert(sources[tid]->isMulti(), "Duplicate single type in signature!")
+            }
+
+            Archetype &arch = archetypeFor(nursery, sig, true);
+            const Location loc = arch.append(id);
+            place(id, loc);
+
+            (putComponent(loc, args), ...);
+            arch.initComponents(core, loc);
+        }
+
+        template< typename T >
+        void putColumn(Archetype &arch, const std::vector< Location > &locs, std::vector< T > &values) {
+            const size_t col = arch.column(DataTypeIndex< T >());
+            for (size_t i = 0; i < locs.size(); ++i) {
+                locs[i].chunk->template column< T >(col).put(locs[i].row, std::move(values[i]));
+            }
+        }
+
+        template< typename ...Types, size_t ...I >
+        void spawnMany(Core &core, const std::vector< EntityID > &ids,
+                       std::tuple< std::vector< Types >... > &components, std::index_sequence< I... >) {
+            const OrderedSignature osig = getOrderedSignature< Types... >();
+            const Signature sig = Entity::getSignature< Types... >();
+            for (const auto tid : getDuplicates(osig)) {
+                rassert(sources.end() != sources.find(tid), "Missing type used!", osig);
+                rassert(sources[tid]->isMulti(), "Duplicate single type in signature!")
+            }
+
+            Archetype &arch = archetypeFor(nursery, sig, true);
+            std::vector< Location > locs;
+            locs.reserve(ids.size());
+            arch.appendMany(ids, locs);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                place(ids[i], locs[i]);
+            }
+            (putColumn(arch, locs, std::get< I >(components)), ...);
+            // Rows were appended a chunk at a time, so hooks can run per chunk
+            for (size_t i = 0; i < locs.size();) {
+                size_t end = i + 1;
+                while (end < locs.size() && locs[end].chunk == locs[i].chunk) { ++end; }
+                arch.initRows(core, *locs[i].chunk, locs[i].row, end - i);
+                i = end;
+            }
+        }
+
+        template< typename T, typename Gen >
+        static std::vector< T > generate(const size_t count, Gen &gen) {
+            std::vector< T > out;
+            out.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                if constexpr (std::is_invocable_r_v< T, Gen &, size_t >) {
+                    out.push_back(gen(i));
+                } else {
+                    out.push_back(gen);
+                }
+            }
+            return out;
+        }
 
+        // Played back changes, the entity may have died since they were recorded
         template< typename T >
-        void addComponentForID(const EntityID id, const T &t, bool graduated) {
-            (graduated ? getSource< std::remove_const_t< T > >() : getNurserySource< std::remove_const_t< T > >()).addThis(id, t);
+        void applyAdd(Core &core, const EntityID eid, const T &component) {
+            const Location *loc = locate(eid);
+            if (!loc) { return; }
+            // A later write to a single component wins
+            if (!sources.at(DataTypeID< T >())->isMulti() && loc->archetype->signature.test(DataTypeIndex< T >())) {
+                putComponent(*loc, component);
+                return;
+            }
+            moveInComponent(core, eid, component);
         }
 
         template< typename T >
-        void removeComponentForID(Core &core, const EntityID id) {
-            auto &source = getSource< std::remove_const_t< T > >();
-            source.deleteComponent(core, id);
-            source.remove(id);
+        void applyRemove(Core &core, const EntityID eid) {
+            const Location *loc = locate(eid);
+            if (!loc || !loc->archetype->signature.test(DataTypeIndex< T >())) { return; }
+            moveOutComponent< T >(core, eid);
         }
 
         Signature getDuplicates(const OrderedSignature &sig) const;
@@ -71,141 +244,159 @@ class Tracker {
 
         void withWriteLock(const std::function< void() > &func);
 
+        // The cached query for key, made from signatures on first use
+        // Note: Needs the read lock held, and the query's own lock to use its matches
+        Query &getQuery(const std::type_index &key, std::vector< Signature > (*signatures)());
+        // Matches archetypes made since the query last looked
+        void updateQuery(Query &query) const;
+
         Signature getRegisteredTypes() const;
 
         size_t sourceCount() const;
 
+        // Note: Only sees graduated entities, and takes no lock
         template< typename T >
-        SourcePtr &getSourcePtr() {
-            const auto loc = sources.find(DataTypeID< std::remove_const_t< T > >());
-            rassert(loc != sources.end(), "Data source is missing", DataTypeName< T >());
-            return loc->second;
-        }
-
-        template< typename T >
-        SourcePtr &getNurserySourcePtr() {
-            const auto loc = nurserySources.find(DataTypeID< std::remove_const_t< T > >());
-            rassert(loc != nurserySources.end(), "Data source is missing", DataTypeName< T >());
-            return loc->second;
-        }
-
-        template< typename T >
-        DataStorageType< T >::Type &getSource() { // TODO: Speedup ?
-            const auto loc = sources.find(DataTypeID< std::remove_const_t< T > >());
-            rassert(loc != sources.end(), "Data source is missing", DataTypeName< T >());
-            return static_cast< DataStorageType< T >::Type & >(*loc->second);
-        }
-
-        template< typename T >
-        DataStorageType< T >::Type &getNurserySource() {
-            const auto loc = nurserySources.find(DataTypeID< std::remove_const_t< T > >());
-            rassert(loc != nurserySources.end(), "Data source is missing", DataTypeName< T >());
-            return static_cast< DataStorageType< T >::Type & >(*loc->second);
+        typename DataStorageType< std::remove_const_t< T > >::Single &componentForID(const EntityID &eid) {
+            auto *component = findComponent< T >(eid);
+            rassert(component, "Entity does not have component", eid, DataTypeName< T >());
+            return *component;
         }
 
         template< typename T >
         bool hasComponent(const EntityID &eid) {
-            // Note: Does not support nursery entities
             std::shared_lock lock(tex);
-            const auto typeID = DataTypeID< std::remove_const_t< T > >();
-            for (const auto &pair : entities) {
-                if (pair.first.count(typeID)) {
-                    if (pair.second.end() != std::find(pair.second.begin(), pair.second.end(), eid)) {
-                        return true;
-                    }
-                }
-            }
-            return false;
+            const Location *loc = locate(eid);
+            return loc && loc->archetype->signature.test(DataTypeIndex< std::remove_const_t< T > >());
         }
 
+        // Note: Does not support nursery entities
         template< typename T >
         std::optional< std::reference_wrapper< T > > optComponent(const EntityID &eid) {
+            CHECK_ACCESS_TO(getConstySignature< T >(), "lookup");
             std::shared_lock lock(tex);
-            return getSource< std::remove_const_t< T > >().optForID(eid);
+            auto *component = findComponent< T >(eid);
+            if (!component) { return std::nullopt; }
+            return std::optional< std::reference_wrapper< T > >{ *component };
         }
 
         template< typename T >
         T &getComponent(const EntityID &eid) {
+            CHECK_ACCESS_TO(getConstySignature< T >(), "lookup");
             std::shared_lock lock(tex);
-            return getSource< std::remove_const_t< T > >().forID(eid);
+            return componentForID< T >(eid);
         }
 
         template< typename T >
         const T &getComponent(const EntityID &eid) const {
+            CHECK_ACCESS_TO(getConstySignature< const T >(), "lookup");
             std::shared_lock lock(tex);
-            return getSource< std::remove_const_t< T > >().forID(eid);
+            const auto *component = findComponent< T >(eid);
+            rassert(component, "Entity does not have component", eid, DataTypeName< T >());
+            return *component;
         }
 
+        // Inside a system, structural changes go to its command buffer
+        // Outside, graduated rows may still be in views someone holds,
+        //      so their changes wait for finalizeKills
         template< typename T >
         void addComponent(Core &core, const EntityID &eid, T &&component) {
-            auto [sig, graduated] = getSignature(eid);
-            std::unique_lock lock(tex);
-
-            Sources *whichSources;
-            Entities *whichEntities;
-            if (graduated) {
-                whichSources = &sources;
-                whichEntities = &entities;
-            } else {
-                whichSources = &nurserySources;
-                whichEntities = &nursery;
+            using Base = std::remove_cvref_t< T >;
+            CommandBuffer *buffer = CommandBuffer::current();
+            std::unique_lock lock(tex, std::defer_lock);
+            if (!buffer) {
+                lock.lock();
+                const Location *found = locate(eid);
+                rassert(found, "Entity is not alive", eid);
+                if (found->archetype->nursery) {
+                    moveInComponent(core, eid, component);
+                    return;
+                }
+                buffer = &deferred;
             }
-
-            auto &group = whichEntities->at(sig);
-            const auto pos = std::find(group.begin(), group.end(), eid);
-            group.erase(pos);
-            const auto res = sig.insert(DataTypeID< T >());
-            rassert(res.second);
-            (*whichEntities)[sig].push_back(eid);
-            addComponentForID(eid, component, graduated);
-            auto &source = *whichSources->at(DataTypeID< T >());
-            source.initComponent(core, eid);
+            buffer->record([this, eid, component = Base(std::forward< T >(component))](Core &core) {
+                applyAdd(core, eid, component);
+            });
         }
 
         template< typename T >
         void removeComponent(Core &core, const EntityID &eid) {
-            Signature sig = getSignature(eid).first; // Has its own lock
-            std::unique_lock lock(tex);
-            auto &group = entities.at(sig);
-            const auto pos = std::find(group.begin(), group.end(), eid);
-            group.erase(pos);
-            const auto res = sig.erase(DataTypeID< T >());
-            rassert(1 == res);
-            entities[sig].push_back(eid);
-            removeComponentForID< T >(core, eid);
+            using Base = std::remove_const_t< T >;
+            CommandBuffer *buffer = CommandBuffer::current();
+            std::unique_lock lock(tex, std::defer_lock);
+            if (!buffer) {
+                lock.lock();
+                const Location *found = locate(eid);
+                rassert(found, "Entity is not alive", eid);
+                if (found->archetype->nursery) {
+                    moveOutComponent< Base >(core, eid);
+                    return;
+                }
+                buffer = &deferred;
+            }
+            buffer->record([this, eid](Core &core) {
+                applyRemove< Base >(core, eid);
+            });
         }
 
+        // Returns the first of the new ids, recycled ids needn't be consecutive
         EntityID createSigned(Core &core, const Signature &sig, size_t count=1);
         template< typename ...Args >
         EntityID create(Core &core, size_t count=1) {
             std::unique_lock lock(tex);
             const OrderedSignature osig = getOrderedSignature< Args... >();
-            const Signature sig(osig.begin(), osig.end());
+            const Signature sig = Entity::getSignature< Args... >();
             for (const auto tid : getDuplicates(osig)) {
                 rassert(sources[tid]->isMulti(), "Duplicate single type in signature!")
             }
             return createSigned(core, sig, count);
         }
 
+        // From a system the id is reserved now, and the entity made at playback
         template< typename ...Args >
         EntityID createWith(Core &core, const Args &... args) {
-            std::unique_lock lock(tex);
-            const OrderedSignature osig = getOrderedSignature< Args... >();
-            const Signature sig(osig.begin(), osig.end());
-            for (const auto tid : getDuplicates(osig)) {
-                rassert(sources.end() != sources.find(tid), "Missing type used!", osig);
-                rassert(sources[tid]->isMulti(), "Duplicate single type in signature!")
+            if (CommandBuffer *buffer = CommandBuffer::current()) {
+                const EntityID id = buffer->reserve(*this);
+                buffer->record([this, id, args...](Core &core) {
+                    spawn(core, id, args...);
+                });
+                return id;
             }
+            std::unique_lock lock(tex);
+            const EntityID id = reserveID();
+            spawn(core, id, args...);
+            return id;
+        }
 
-            const EntityID id = nextID++;
-            nursery[sig].push_back(id);
-
-            (addComponentForID(id, args, false), ...);
-            for (const auto tid : sig) {
-                nurserySources[tid]->initComponent(core, id);
+        // Makes count entities with one signature lookup and one pass per column
+        // Each argument is either a component every entity shares,
+        //      or a generator called with the entity's index in the batch
+        // Generators all run before this returns, even when called from a system
+        template< typename ...Types, typename ...Gens >
+        std::vector< EntityID > createMany(Core &core, const size_t count, Gens &&... gens) {
+            static_assert(sizeof...(Types) == sizeof...(Gens), "Need one generator per component");
+            using Components = std::tuple< std::vector< Types >... >;
+            using Indices = std::index_sequence_for< Types... >;
+            if (0 == count) { return {}; }
+            // Braced, so generators run in argument order
+            auto components = std::make_shared< Components >(Components{ generate< Types >(count, gens)... });
+            std::vector< EntityID > ids;
+            ids.reserve(count);
+
+            if (CommandBuffer *buffer = CommandBuffer::current()) {
+                for (size_t i = 0; i < count; ++i) {
+                    ids.push_back(buffer->reserve(*this));
+                }
+                buffer->record([this, ids, components](Core &core) {
+                    spawnMany(core, ids, *components, Indices{});
+                });
+                return ids;
             }
-
-            return id;
+            std::unique_lock lock(tex);
+            for (size_t i = 0; i < count; ++i) {
+                ids.push_back(reserveID());
+            }
+            spawnMany(core, ids, *components, Indices{});
+            return ids;
         }
 
         template< typename T >
@@ -213,18 +404,22 @@ class Tracker {
             std::unique_lock lock(tex);
 
             auto standard = std::make_unique< T >();
+            registerTypeIndex(standard->type());
 
             if (sources.end() != sources.find(standard->type())) {
                 return;
             }
 
             sources[standard->type()] = std::move(standard);
-
-            auto younger = std::make_unique< T >();
-            nurserySources[younger->type()] = std::move(younger);
         }
 
+        // Around a tick's systems, one lane for each, see reserveLaneIDs
+        // Closing frees the slots of blocks no lane got to
+        void openLanes(const size_t lanes);
+        void closeLanes();
+
         void killEntity(Core &core, const EntityID id);
+        // Plays back changes deferred from outside systems, then reaps the doomed
         void finalizeKills(Core &core);
 
         void killAll(Core &core);
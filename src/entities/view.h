@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+
+namespace Entity {
+
+// Span over the rows of several chunks, indexed as one sequence
+// Like std::span it doesn't own the rows, so constness comes from T
+// Views are only valid until the tick's structural changes are applied
+template< typename T >
+class View {
+    public:
+        typedef T value_type;
+
+        struct Segment {
+            T *rows;
+            size_t start;
+            size_t size;
+        };
+
+        class iterator {
+            const View *view;
+            size_t segment;
+            size_t offset;
+
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef T value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef T *pointer;
+                typedef T &reference;
+
+                iterator(): view(nullptr), segment(0), offset(0) { }
+                iterator(const View *view, size_t segment): view(view), segment(segment), offset(0) { }
+
+                T &operator*() const { return view->segments[segment].rows[offset]; }
+                T *operator->() const { return &**this; }
+
+                iterator &operator++() {
+                    if (++offset == view->segments[segment].size) {
+                        ++segment;
+                        offset = 0;
+                    }
+                    return *this;
+                }
+
+                iterator operator++(int) {
+                    iterator old = *this;
+                    ++*this;
+                    return old;
+                }
+
+                bool operator==(const iterator &other) const {
+                    return segment == other.segment && offset == other.offset;
+                }
+
+                bool operator!=(const iterator &other) const {
+                    return !(*this == other);
+                }
+        };
+
+    private:
+        std::vector< Segment > segments;
+        size_t total = 0;
+
+        size_t findSegment(const size_t i) const {
+            const auto loc = std::upper_bound(segments.begin(), segments.end(), i,
+                [](const size_t index, const Segment &seg) { return index < seg.start; });
+            return static_cast< size_t >(loc - segments.begin()) - 1;
+        }
+
+    public:
+        void reserve(const size_t count) {
+            segments.reserve(count);
+        }
+
+        void add(T *rows, const size_t size) {
+            if (0 == size) { return; }
+            segments.push_back(Segment{ rows, total, size });
+            total += size;
+        }
+
+        const std::vector< Segment > &getSegments() const {
+            return segments;
+        }
+
+        size_t size() const {
+            return total;
+        }
+
+        bool empty() const {
+            return 0 == total;
+        }
+
+        // Stateless, so one view can be read from several threads at once
+        T &operator[](const size_t i) const {
+            const Segment &seg = segments[findSegment(i)];
+            return seg.rows[i - seg.start];
+        }
+
+        iterator begin() const {
+            return iterator(this, 0);
+        }
+
+        iterator end() const {
+            return iterator(this, segments.size());
+        }
+};
+
+}
@@ -1,6 +1,7 @@
 #include "game/ash.h"
 
 #include "game/npc.h"
+#include "game/spatial.h"
 #include "core/core.h"
 #include "visual/camera.h"
 #include "visual/visuals.h"
@@ -15,7 +16,7 @@ std::vector< Entity::EntityID > findScores(Core &core) {
     std::vector< Entity::EntityID > out;
     Entity::Exec< Entity::Packs< const Score > >::run(core.tracker,
     [&](const auto &scores) {
-        out = scores.second;
+        out.assign(scores.second.begin(), scores.second.end());
     });
     return out;
 }
@@ -30,6 +31,7 @@ void ASHGame::registration(Core &core) {
     core.tracker.addSource< ColourData >();
     core.systems.addSystem(std::make_unique< ControllerSystem >());
     core.systems.addSystem(std::make_unique< PhysicsSystem >());
+    core.systems.addSystem(std::make_unique< SpatialIndexSystem >());
     core.systems.addSystem(std::make_unique< DamageSystem >());
     core.systems.addSystem(std::make_unique< SeekerSystem >());
     core.systems.addSystem(std::make_unique< TurretSystem >());
@@ -60,12 +62,13 @@ void ASHGame::create(Core &core) {
         10.0, 1.0, 0.5, 2.0, true
     });
 
-    player_1 = core.tracker.createWith(core,
-        PhysBody{ makeCircle(core, Point(-64.0, 0.0), 3.0, PhysProperties{
+    player_1 = createBody(core.tracker, core,
+        makeCircle(core, Point(-64.0, 0.0), 3.0, PhysProperties{
             .dynamic = true, .rotates = false, .category = 0x0011
-        } ) },
+        } ),
         Colour{ { 0x00, 0xAA, 0x00 } },
         HitData{},
+        Push{},
         Controller{ KeyboardController, Layout{
             {"up", SDLK_w},
             {"down", SDLK_s},
@@ -84,12 +87,13 @@ void ASHGame::create(Core &core) {
         Turret{ "primary", bul, 0.33, 0.0, 0.0, false }
     );
 
-    player_2 = core.tracker.createWith(core,
-        PhysBody{ makeCircle(core, Point(64.0, 0.0), 3.0, PhysProperties{
+    player_2 = createBody(core.tracker, core,
+        makeCircle(core, Point(64.0, 0.0), 3.0, PhysProperties{
             .dynamic = true, .rotates = false, .category = 0x0011
-        } ) },
+        } ),
         Colour{ { 0x00, 0x00, 0xAA } },
         HitData{},
+        Push{},
         Controller{ KeyboardController, Layout{
             {"up", SDLK_i},
             {"down", SDLK_k},
@@ -116,32 +120,32 @@ void ASHGame::create(Core &core) {
         .category = 0x0010,
         .mask = 0x0010
     };
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(0, 0), 2, 256 + widths, divider) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(0, 0), 2, 256 + widths, divider),
         Colour{ { 0x33, 0, 0 } },
         Damage{ std::numeric_limits< double >::infinity() }
     );
 
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(-128, 0), widths, 256 + widths, PhysProperties{ .dynamic = false, .rotates = false}) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(-128, 0), widths, 256 + widths, PhysProperties{ .dynamic = false, .rotates = false}),
         Colour{ { 0xFF, 0, 0 } },
         Damage{ std::numeric_limits< double >::infinity() }
     );
 
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(128, 0), widths, 256 + widths, PhysProperties{ .dynamic = false, .rotates = false}) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(128, 0), widths, 256 + widths, PhysProperties{ .dynamic = false, .rotates = false}),
         Colour{ { 0xFF, 0, 0 } },
         Damage{ std::numeric_limits< double >::infinity() }
     );
 
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(0, 128.0), 256 + widths, widths, PhysProperties{ .dynamic = false, .rotates = false}) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(0, 128.0), 256 + widths, widths, PhysProperties{ .dynamic = false, .rotates = false}),
         Colour{ { 0xFF, 0, 0 } },
         Damage{ std::numeric_limits< double >::infinity() }
     );
 
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(0, -128.0), 256 + widths, widths, PhysProperties{ .dynamic = false, .rotates = false}) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(0, -128.0), 256 + widths, widths, PhysProperties{ .dynamic = false, .rotates = false}),
         Colour{ { 0xFF, 0, 0 } },
         Damage{ std::numeric_limits< double >::infinity() }
     );
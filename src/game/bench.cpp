@@ -0,0 +1,83 @@
+#include "game/bench.h"
+
+#include "game/game.h"
+#include "core/core.h"
+#include "entities/tracker.h"
+#include "entities/systems.h"
+#include "utility/timers.h"
+#include "utility/alloc.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace {
+
+void restart(Core &core, Game &game) {
+    game.cleanup(core);
+    core.tracker.killAll(core);
+    core.tracker.finalizeKills(core);
+    game.create(core);
+    core.tracker.graduate();
+}
+
+}
+
+void runBench(Core &core, Game &game, std::ostream &report) {
+    const size_t steps = core.options["steps"].as< size_t >();
+    const double step_seconds = 1.0 / core.options["lps"].as< double >();
+
+    restart(core, game);
+    // Setup isn't part of the run
+    core.systems.latencies();
+
+    const size_t start_entities = core.tracker.count();
+    size_t peak_entities = start_entities;
+    size_t restarts = 0;
+    HistogramTimer ticks;
+
+    const Alloc::Counts allocs_before = Alloc::counts();
+    Alloc::count(true);
+    const auto start = std::chrono::high_resolution_clock::now();
+    for (size_t step = 0; step < steps; ++step) {
+        if (game.update(core)) {
+            restart(core, game);
+            ++restarts;
+        }
+        ticks.add([&](){
+            core.systems.execute(core, step_seconds);
+            core.tracker.graduate();
+        });
+        peak_entities = std::max(peak_entities, core.tracker.count());
+    }
+    const std::chrono::duration< double > seconds = std::chrono::high_resolution_clock::now() - start;
+    Alloc::count(false);
+    const Alloc::Counts allocs_after = Alloc::counts();
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    report << "{\"scenario\":\"" << core.options["game"].as< std::string >() << '"'
+           << ",\"seed\":" << core.options["seed"].as< uint64_t >()
+           << ",\"threads\":" << core.systems.width()
+           << ",\"steps\":" << steps
+           << ",\"restarts\":" << restarts
+           << ",\"seconds\":" << seconds.count()
+           << ",\"steps_per_second\":" << ((seconds.count() > 0.0) ? steps / seconds.count() : 0.0)
+           << ",\"tick\":";
+    writeJSON(report, ticks.summary());
+    report << ",\"systems\":{";
+    const auto latencies = core.systems.latencies();
+    for (size_t i = 0; i < latencies.size(); ++i) {
+        report << ((0 == i) ? "" : ",") << '"' << latencies[i].first << "\":";
+        writeJSON(report, latencies[i].second);
+    }
+    report << "},\"entities\":{\"start\":" << start_entities
+           << ",\"end\":" << core.tracker.count()
+           << ",\"peak\":" << peak_entities << '}'
+           << ",\"peak_rss_kb\":" << usage.ru_maxrss
+           << ",\"allocations\":" << allocs_after.allocations - allocs_before.allocations
+           << ",\"allocated_bytes\":" << allocs_after.bytes - allocs_before.bytes
+           << "}" << std::endl;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <ostream>
+
+struct Core;
+class Game;
+
+// Runs a game for --steps logic steps as fast as it'll go, without rendering or input,
+//      then writes a JSON report of how it went
+// Random streams are seeded from --seed, so with -j 1 runs repeat exactly
+void runBench(Core &core, Game &game, std::ostream &report);
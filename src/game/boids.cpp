@@ -0,0 +1,303 @@
+#include "game/boids.h"
+
+#include "utility/utility.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__)
+#define BOIDS_X86
+#include <immintrin.h>
+#endif
+
+namespace Boids {
+
+namespace {
+
+// Sums dx * w and dy * w over swarm mates in sorted drones [from, to), where w turns the
+//      offset into a unit vector scaled by how far inside the bubble it is
+typedef void (*Avoider)(const float *xs, const float *ys, const int32_t *tags, const size_t from, const size_t to,
+                        const float x, const float y, const int32_t tag, const float shy, float &sx, float &sy);
+
+void avoidScalar(const float *xs, const float *ys, const int32_t *tags, const size_t from, const size_t to,
+                 const float x, const float y, const int32_t tag, const float shy, float &sx, float &sy) {
+    for (size_t j = from; j < to; ++j) {
+        const float dx = xs[j] - x;
+        const float dy = ys[j] - y;
+        const float d2 = dx * dx + dy * dy;
+        if (tags[j] != tag || d2 >= shy || d2 <= 0.0f) { continue; }
+        const float w = (shy - d2) / (shy * std::sqrt(d2));
+        sx += dx * w;
+        sy += dy * w;
+    }
+}
+
+#ifdef BOIDS_X86
+
+// SSE2 is part of x86-64, so this needs no check
+void avoidSSE(const float *xs, const float *ys, const int32_t *tags, const size_t from, const size_t to,
+              const float x, const float y, const int32_t tag, const float shy, float &sx, float &sy) {
+    const __m128 vx = _mm_set1_ps(x);
+    const __m128 vy = _mm_set1_ps(y);
+    const __m128 vshy = _mm_set1_ps(shy);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i vtag = _mm_set1_epi32(tag);
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    __m128 ax = zero;
+    __m128 ay = zero;
+    for (size_t j = from; j < to; j += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + j), vx);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + j), vy);
+        const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        // Mates inside the bubble, other than itself, and not past the run's end
+        const __m128i mate = _mm_and_si128(
+            _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast< const __m128i * >(tags + j)), vtag),
+            _mm_cmpgt_epi32(_mm_set1_epi32(int32_t(to - j)), lane));
+        const __m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(d2, vshy), _mm_cmpgt_ps(d2, zero)),
+                                       _mm_castsi128_ps(mate));
+        const __m128 w = _mm_and_ps(mask, _mm_div_ps(_mm_sub_ps(vshy, d2), _mm_mul_ps(vshy, _mm_sqrt_ps(d2))));
+        ax = _mm_add_ps(ax, _mm_mul_ps(dx, w));
+        ay = _mm_add_ps(ay, _mm_mul_ps(dy, w));
+    }
+    alignas(16) float lx[4], ly[4];
+    _mm_store_ps(lx, ax);
+    _mm_store_ps(ly, ay);
+    sx += (lx[0] + lx[1]) + (lx[2] + lx[3]);
+    sy += (ly[0] + ly[1]) + (ly[2] + ly[3]);
+}
+
+__attribute__((target("avx2")))
+void avoidAVX2(const float *xs, const float *ys, const int32_t *tags, const size_t from, const size_t to,
+               const float x, const float y, const int32_t tag, const float shy, float &sx, float &sy) {
+    const __m256 vx = _mm256_set1_ps(x);
+    const __m256 vy = _mm256_set1_ps(y);
+    const __m256 vshy = _mm256_set1_ps(shy);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i vtag = _mm256_set1_epi32(tag);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256 ax = zero;
+    __m256 ay = zero;
+    for (size_t j = from; j < to; j += 8) {
+        const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + j), vx);
+        const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + j), vy);
+        const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        const __m256i mate = _mm256_and_si256(
+            _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast< const __m256i * >(tags + j)), vtag),
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(int32_t(to - j)), lane));
+        const __m256 mask = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(d2, vshy, _CMP_LT_OQ), _mm256_cmp_ps(d2, zero, _CMP_GT_OQ)),
+            _mm256_castsi256_ps(mate));
+        const __m256 w = _mm256_and_ps(mask,
+            _mm256_div_ps(_mm256_sub_ps(vshy, d2), _mm256_mul_ps(vshy, _mm256_sqrt_ps(d2))));
+        ax = _mm256_add_ps(ax, _mm256_mul_ps(dx, w));
+        ay = _mm256_add_ps(ay, _mm256_mul_ps(dy, w));
+    }
+    alignas(32) float lx[8], ly[8];
+    _mm256_store_ps(lx, ax);
+    _mm256_store_ps(ly, ay);
+    sx += ((lx[0] + lx[1]) + (lx[2] + lx[3])) + ((lx[4] + lx[5]) + (lx[6] + lx[7]));
+    sy += ((ly[0] + ly[1]) + (ly[2] + ly[3])) + ((ly[4] + ly[5]) + (ly[6] + ly[7]));
+}
+
+#endif
+
+Avoider avoider(const Level level) {
+    switch (level) {
+#ifdef BOIDS_X86
+        case Level::AVX2: return avoidAVX2;
+        case Level::SSE: return avoidSSE;
+#endif
+        default: return avoidScalar;
+    }
+}
+
+// Like normalized, zero stays zero
+void normalize(float &x, float &y) {
+    const float length = std::sqrt(x * x + y * y);
+    if (0.0f == length) { return; }
+    x /= length;
+    y /= length;
+}
+
+}
+
+Level bestLevel() {
+#ifdef BOIDS_X86
+    if (__builtin_cpu_supports("avx2")) { return Level::AVX2; }
+    return Level::SSE;
+#else
+    return Level::Scalar;
+#endif
+}
+
+Level parseLevel(const std::string &name) {
+    const Level best = bestLevel();
+    if ("auto" == name) { return best; }
+    for (const Level level : { Level::Scalar, Level::SSE, Level::AVX2 }) {
+        if (name == levelName(level)) {
+            rassert(level <= best, "This CPU can't run that boid kernel", name, levelName(best));
+            return level;
+        }
+    }
+    rassert(false, "Unknown boid kernel", name);
+    return best;
+}
+
+const char *levelName(const Level level) {
+    switch (level) {
+        case Level::AVX2: return "avx2";
+        case Level::SSE: return "sse";
+        default: return "scalar";
+    }
+}
+
+void merge(const std::vector< Sum > &part, std::vector< Sum > &total) {
+    for (size_t tag = 0; tag < part.size(); ++tag) {
+        total[tag].x += part[tag].x;
+        total[tag].y += part[tag].y;
+        total[tag].vx += part[tag].vx;
+        total[tag].vy += part[tag].vy;
+        total[tag].count += part[tag].count;
+    }
+}
+
+void finish(const std::vector< Sum > &sums, std::vector< Swarm > &swarms) {
+    swarms.resize(sums.size());
+    for (size_t tag = 0; tag < sums.size(); ++tag) {
+        const Sum &sum = sums[tag];
+        Swarm &swarm = swarms[tag];
+        swarm.count = sum.count;
+        if (0 == sum.count) {
+            swarm = Swarm{};
+            continue;
+        }
+        swarm.centreX = float(sum.x / sum.count);
+        swarm.centreY = float(sum.y / sum.count);
+        swarm.headingX = float(sum.vx);
+        swarm.headingY = float(sum.vy);
+        normalize(swarm.headingX, swarm.headingY);
+    }
+}
+
+void Flock::clear() {
+    inX.clear();
+    inY.clear();
+    inVX.clear();
+    inVY.clear();
+    inTag.clear();
+    highest = 0;
+}
+
+void Flock::add(const float x, const float y, const float vx, const float vy, const uint16_t tag) {
+    inX.push_back(x);
+    inY.push_back(y);
+    inVX.push_back(vx);
+    inVY.push_back(vy);
+    inTag.push_back(tag);
+    highest = std::max(highest, tag);
+}
+
+void Flock::sum(const size_t begin, const size_t end, std::vector< Sum > &sums) const {
+    for (size_t i = begin; i < end; ++i) {
+        Sum &sum = sums[inTag[i]];
+        ++sum.count;
+        sum.x += inX[i];
+        sum.y += inY[i];
+        float vx = inVX[i], vy = inVY[i];
+        normalize(vx, vy);
+        sum.vx += vx;
+        sum.vy += vy;
+    }
+}
+
+void Flock::prepare(const float reach) {
+    const size_t n = inX.size();
+
+    // A touch over reach, so rounding never puts mates in reach two cells apart
+    cell = std::max(reach, 1.0f) * (1.0f + 1.0f / 1024.0f);
+    left = bottom = 0.0f;
+    float right = 0.0f, top = 0.0f;
+    if (n > 0) {
+        left = right = inX[0];
+        bottom = top = inY[0];
+        for (size_t i = 1; i < n; ++i) {
+            left = std::min(left, inX[i]);
+            right = std::max(right, inX[i]);
+            bottom = std::min(bottom, inY[i]);
+            top = std::max(top, inY[i]);
+        }
+    }
+    // Strays far out would make a grid mostly empty cells, bigger cells keep it to a few a drone
+    const uint64_t most = std::max(uint64_t(64), 4 * uint64_t(n));
+    while (true) {
+        cols = uint32_t(std::min(double(most), std::floor(double(right - left) / cell) + 1.0));
+        rows = uint32_t(std::min(double(most), std::floor(double(top - bottom) / cell) + 1.0));
+        if (uint64_t(cols) * rows <= most) { break; }
+        cell *= 2.0f;
+    }
+
+    inCell.resize(n);
+    starts.assign(size_t(cols) * rows + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t cx = std::min(cols - 1, uint32_t((inX[i] - left) / cell));
+        const uint32_t cy = std::min(rows - 1, uint32_t((inY[i] - bottom) / cell));
+        inCell[i] = cy * cols + cx;
+        ++starts[inCell[i] + 1];
+    }
+    for (size_t c = 1; c < starts.size(); ++c) {
+        starts[c] += starts[c - 1];
+    }
+
+    cursors.assign(starts.begin(), starts.end() - 1);
+    xs.assign(n + LANES, 0.0f);
+    ys.assign(n + LANES, 0.0f);
+    // Padding matches no swarm, tags are all 16 bit
+    tags.assign(n + LANES, -1);
+    cells.resize(n);
+    order.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t s = cursors[inCell[i]]++;
+        xs[s] = inX[i];
+        ys[s] = inY[i];
+        tags[s] = inTag[i];
+        cells[s] = inCell[i];
+        order[s] = i;
+    }
+}
+
+void Flock::forces(const std::vector< Swarm > &swarms, const Params &params, const Level level,
+                   const size_t begin, const size_t end, float *fx, float *fy) const {
+    const Avoider avoid = avoider(level);
+    const float shy = params.reach * params.reach;
+    for (size_t s = begin; s < end; ++s) {
+        const float x = xs[s];
+        const float y = ys[s];
+
+        float sx = 0.0f, sy = 0.0f;
+        if (shy > 0.0f) {
+            const uint32_t cx = cells[s] % cols;
+            const uint32_t cy = cells[s] / cols;
+            const uint32_t west = (cx > 0) ? cx - 1 : cx;
+            const uint32_t east = std::min(cols - 1, cx + 1);
+            for (uint32_t row = (cy > 0) ? cy - 1 : cy; row <= std::min(rows - 1, cy + 1); ++row) {
+                avoid(xs.data(), ys.data(), tags.data(), starts[row * cols + west], starts[row * cols + east + 1],
+                      x, y, tags[s], shy, sx, sy);
+            }
+        }
+
+        const Swarm &swarm = swarms[tags[s]];
+        float gx = swarm.centreX - x, gy = swarm.centreY - y;
+        normalize(gx, gy);
+        float ax = -sx, ay = -sy;
+        normalize(ax, ay);
+        float tx = -x, ty = -y;
+        normalize(tx, ty);
+        const float centre_dist = x * x + y * y;
+        const float pull = (centre_dist < params.tether * params.tether) ? 0.0f : centre_dist / params.tether;
+
+        fx[s] = gx * params.group + swarm.headingX * params.align + ax * params.avoid + tx * pull * 10.0f;
+        fy[s] = gy * params.group + swarm.headingY * params.align + ay * params.avoid + ty * pull * 10.0f;
+    }
+}
+
+}
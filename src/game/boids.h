@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Swarm steering over flat float arrays, with the pairwise part in SIMD lanes
+// Which instruction set runs is picked at runtime, so one build runs anywhere
+namespace Boids {
+
+// Kernels there are, worst to best
+enum class Level { Scalar, SSE, AVX2 };
+
+// The best this CPU can run
+Level bestLevel();
+// From an option, auto, avx2, sse or scalar
+Level parseLevel(const std::string &name);
+const char *levelName(const Level level);
+
+struct Params {
+    float avoid;
+    float align;
+    float group;
+    // How close swarm mates get before they push apart
+    float reach;
+    // How far out drones roam before being pulled back towards the centre
+    float tether;
+};
+
+// One swarm's drones summed up, in doubles so big swarms don't lose their centre
+struct Sum {
+    double x = 0.0, y = 0.0;
+    double vx = 0.0, vy = 0.0;
+    uint32_t count = 0;
+};
+
+// One swarm's centre and heading, for steering
+struct Swarm {
+    float centreX = 0.0f, centreY = 0.0f;
+    // Where the swarm's going on average, normalised
+    float headingX = 0.0f, headingY = 0.0f;
+    uint32_t count = 0;
+};
+
+// Totals into the swarm they add to, both indexed by tag and as long as each other
+void merge(const std::vector< Sum > &part, std::vector< Sum > &total);
+// Totals into centres and headings, swarms is resized to match
+void finish(const std::vector< Sum > &sums, std::vector< Swarm > &swarms);
+
+// One tick's drones, gathered once and sorted into grid cells so neighbours sit together
+// Note: Buffers are kept between ticks, so once the flock's stopped growing it doesn't allocate
+class Flock {
+    public:
+        // Widest lanes there are, the arrays are padded by this so loads past the end stay in bounds
+        static constexpr size_t LANES = 8;
+
+    private:
+        // As added
+        std::vector< float > inX, inY, inVX, inVY;
+        std::vector< uint16_t > inTag;
+        std::vector< uint32_t > inCell;
+        uint16_t highest = 0;
+        // Sorted by cell
+        std::vector< float > xs, ys;
+        std::vector< int32_t > tags;
+        std::vector< uint32_t > cells;
+        std::vector< uint32_t > order;
+        // Cells are row major, each row's drones are contiguous so three neighbouring cells are one run
+        float left, bottom, cell;
+        uint32_t cols, rows;
+        std::vector< uint32_t > starts;
+        std::vector< uint32_t > cursors;
+
+    public:
+        void clear();
+        void add(const float x, const float y, const float vx, const float vy, const uint16_t tag);
+
+        // Drones added, before or after prepare
+        size_t size() const { return inX.size(); }
+        // Sums need a slot for every tag up to this
+        uint16_t highestTag() const { return highest; }
+        // Adds drones [begin, end), counting in the order they were added, to sums indexed by tag
+        // Note: Safe to call from several threads at once with their own sums
+        void sum(const size_t begin, const size_t end, std::vector< Sum > &sums) const;
+
+        // Sorts into cells at least reach across, needed before forces
+        void prepare(const float reach);
+        // Which drone, counting in the order they were added, is at sorted position s
+        size_t added(const size_t s) const { return order[s]; }
+        // Steering for sorted drones [begin, end), into fx and fy at the same positions
+        // swarms is indexed by tag, as finish leaves it
+        // Note: Safe to call from several threads at once on disjoint ranges
+        void forces(const std::vector< Swarm > &swarms, const Params &params, const Level level,
+                    const size_t begin, const size_t end, float *fx, float *fy) const;
+};
+
+}
@@ -11,6 +11,7 @@
 #include "core/core.h"
 #include "core/geometry.h"
 #include "game/npc.h"
+#include "game/spatial.h"
 
 static const size_t WORLD_SIZE = 1000.0;
 
@@ -30,6 +31,7 @@ void SwarmGame::registration(Core &core) {
     core.tracker.addSource< ColourData >();
     core.systems.addSystem(std::make_unique< ControllerSystem >());
     core.systems.addSystem(std::make_unique< PhysicsSystem >());
+    core.systems.addSystem(std::make_unique< SpatialIndexSystem >());
     core.systems.addSystem(std::make_unique< DamageSystem >());
     core.systems.addSystem(std::make_unique< SeekerSystem >());
     core.systems.addSystem(std::make_unique< TurretSystem >());
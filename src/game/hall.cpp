@@ -1,6 +1,7 @@
 #include "game/hall.h"
 
 #include "game/npc.h"
+#include "game/spatial.h"
 #include "core/core.h"
 #include "visual/camera.h"
 #include "visual/visuals.h"
@@ -18,6 +19,7 @@ void HallGame::registration(Core &core) {
     core.tracker.addSource< ColourData >();
     core.systems.addSystem(std::make_unique< ControllerSystem >());
     core.systems.addSystem(std::make_unique< PhysicsSystem >());
+    core.systems.addSystem(std::make_unique< SpatialIndexSystem >());
     core.systems.addSystem(std::make_unique< DamageSystem >());
     core.systems.addSystem(std::make_unique< SeekerSystem >());
     core.systems.addSystem(std::make_unique< TurretSystem >());
@@ -34,17 +36,18 @@ void HallGame::unregister(Core &) {
 
 void HallGame::create(Core &core) {
     // Make the floor
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(0.0, -5.0), 128.0, 5.0, PhysProperties{.dynamic = false}) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(0.0, -5.0), 128.0, 5.0, PhysProperties{.dynamic = false}),
         Colour{ { 0, 0xFF, 0 } }
     );
 
     // Make the player
-    core.tracker.createWith(core,
-        PhysBody{ makeRect(core, Point(0.0, 5.0), 3.0, 8.0, PhysProperties{.dynamic = true, .rotates=false}) },
+    createBody(core.tracker, core,
+        makeRect(core, Point(0.0, 5.0), 3.0, 8.0, PhysProperties{.dynamic = true, .rotates=false}),
         Colour{ { 0xAA, 0xAA, 0xAA } },
         HitData{},
         Damage{ 0.2 },
+        Push{},
         Controller{ KeyboardController, Layout{ {"up", SDLK_w } } },
         Team{ 0 },
         fullHealth( std::numeric_limits< double >::infinity() )
@@ -52,8 +55,8 @@ void HallGame::create(Core &core) {
 
     // Make a turret
     /*
-    core.tracker.createWith(core,
-        PhysBody{ makeCircle(core, Point(10.0, 10.0), 2.0, false) },
+    createBody(core.tracker, core,
+        makeCircle(core, Point(10.0, 10.0), 2.0, false),
         Colour{ { 0xFF, 0, 0 } },
         HitData{},
         fullHealth(10.0),
@@ -34,13 +34,14 @@ bool Liner::update(Core &) {
 }
 
 void Liner::create(Core &core) {
-    const auto tid = core.tracker.createWith(core,
-        PhysBody{ randomBall(core, 1.0) },
+    const auto tid = createBody(core.tracker, core,
+        randomBall(core, 1.0),
         Colour{ { 0x00, 0x00, 0x00 } }
     );
-    core.tracker.createWith(core,
-        PhysBody{ randomBall(core, 1.0) },
+    createBody(core.tracker, core,
+        randomBall(core, 1.0),
         Colour{ { 0xFF, 0xFF, 0xFF } },
+        Push{},
         Controller{ KeyboardController, Layout{
             {"up", SDLK_w},
             {"down", SDLK_w},
@@ -1,4 +1,5 @@
 #include "game/npc.h"
+#include "game/spatial.h"
 
 #include "core/core.h"
 #include "core/geometry.h"
@@ -23,7 +24,7 @@ b2Body *randomBall(Core &core, double rad) {
 }
 
 DamageSystem::DamageSystem()
-    : BaseSystem("Damage", Entity::getConstySignature< Health, const HitData, const Team, const Damage >()) {
+    : BaseSystem("Damage", Entity::Queries< Victims, Hitters >::access()) {
 }
 
 DamageSystem::~DamageSystem() { }
@@ -35,13 +36,14 @@ void DamageSystem::init(Core &core) {
 }
 
 void DamageSystem::execute(Core &core, double) {
-    std::vector< Entity::EntityID > kill;
-    Entity::Exec< Entity::Packs< const HitData, Health >, Entity::Packs< const HitData, Health, const Team > >::run(core.tracker,
-    [&](auto &noteam, auto &team) {
+    typedef std::vector< Entity::EntityID > Kills;
+    const auto kills = Victims::parallel< Kills >(
+    core.tracker, core.systems,
+    [&](auto &noteam, auto &team, const Entity::Slice &slice, Kills &kill) {
         {
             const auto &hits = noteam.first.template get< const HitData >();
             auto &healths = noteam.first.template get< Health >();
-            for (size_t i = 0; i < hits.size(); ++i) {
+            for (size_t i = slice.begin(0); i < slice.end(0); ++i) {
                 for (const auto hit : hits[i].id) {
                     const auto optDmg = core.tracker.optComponent< const Damage >(hit);
                     if (optDmg) {
@@ -57,7 +59,7 @@ void DamageSystem::execute(Core &core, double) {
             const auto &hits = team.first.template get< const HitData >();
             auto &healths = team.first.template get< Health >();
             const auto &teams = team.first.template get< const Team >();
-            for (size_t i = 0; i < hits.size(); ++i) {
+            for (size_t i = slice.begin(1); i < slice.end(1); ++i) {
                 for (const auto hit : hits[i].id) {
                     const auto optTeam = core.tracker.optComponent< const Team >(hit);
                     if (optTeam && optTeam->get().team == teams[i].team) { continue; }
@@ -72,13 +74,15 @@ void DamageSystem::execute(Core &core, double) {
             }
         }
     });
-    for (const auto eid : kill) {
-        core.tracker.killEntity(core, eid);
+    for (const auto &kill : kills) {
+        for (const auto eid : kill) {
+            core.tracker.killEntity(core, eid);
+        }
     }
 }
 
 SeekerSystem::SeekerSystem()
-    : BaseSystem("Seeker", Entity::getConstySignature< PhysBody, const Seeker, const TargetValue, const Team >()) {
+    : BaseSystem("Seeker", Entity::Queries< Seekers, Chased, Targets >::access()) {
 }
 
 SeekerSystem::~SeekerSystem() { }
@@ -95,7 +99,7 @@ void SeekerSystem::execute(Core &core, double time_delta) {
 
     std::vector< size_t > retargets;
 
-    const auto seek = [&](size_t index, PhysBody &pb, Seeker &seeker, bool teamed) {
+    const auto seek = [&](size_t index, const Transform &transform, Seeker &seeker, Push &push, bool teamed) {
         const auto tid = seeker.target;
         if (!core.tracker.alive(tid)) {
             if (teamed && seeker.retargeting) {
@@ -104,96 +108,69 @@ void SeekerSystem::execute(Core &core, double time_delta) {
             return;
         }
 
-        const auto target_body = core.tracker.optComponent< PhysBody >(tid);
-        if (!target_body) {
+        const auto target_transform = core.tracker.optComponent< const Transform >(tid);
+        const auto target_velocity = core.tracker.optComponent< const Velocity >(tid);
+        if (!target_transform || !target_velocity) {
             return;
         }
 
-        const auto body = pb.body;
-        const b2Body *target = target_body->get().body;
-
-        const auto target_at = VPC< Vec >(target->GetPosition());
-        const auto me_at = VPC< Vec >(body->GetPosition());
+        const auto target_at = target_transform->get().at;
+        const auto me_at = transform.at;
         const double estimate_intercept_t = (target_at - me_at).squared_length() / tick_velo;
 
-        const auto target_velo = VPC< Vec >(target->GetLinearVelocity());
+        const auto target_velo = target_velocity->get().linear;
         const auto target_predicted = target_at + target_velo * estimate_intercept_t * 2.0;
 
         const auto vec_to = target_predicted - me_at;
 
-        const auto go = force * normalized(vec_to);
-        body->ApplyForceToCenter(VPC< b2Vec2 >(go), true);
+        push.force += force * normalized(vec_to);
+        push.wake = true;
     };
 
-    Entity::Exec<
-        Entity::Packs< PhysBody, Seeker >,
-        Entity::Packs< PhysBody, Seeker, const Team >
-    >::run(core.tracker,
+    Seekers::run(core.tracker,
     [&](auto &unteamed, auto &teamed) {
         for (size_t i = 0; i < unteamed.second.size(); ++i) {
-            seek(i, unteamed.first.template get< PhysBody >()[i],
+            seek(i, unteamed.first.template get< const Transform >()[i],
                     unteamed.first.template get< Seeker >()[i],
+                    unteamed.first.template get< Push >()[i],
                     false);
         }
         for (size_t i = 0; i < teamed.second.size(); ++i) {
-            seek(i, teamed.first.template get< PhysBody >()[i],
+            seek(i, teamed.first.template get< const Transform >()[i],
                     teamed.first.template get< Seeker >()[i],
+                    teamed.first.template get< Push >()[i],
                     true);
         }
 
         if (retargets.empty()) {
             return;
         }
-        std::map< uint16_t, std::vector< size_t > > teamy;
-        for (size_t i = 0; i < retargets.size(); ++i) {
-            const auto team = teamed.first.template get< const Team >()[i];
-            teamy[team.team].push_back(i);
-        }
-
-        Entity::ExecSimple< const PhysBody, const TargetValue, const Team >::run(core.tracker,
-        [&](const auto &ids, const auto &tbodies, const auto &values, const auto &teams) {
-            for (const auto &pair : teamy) {
-                for (const size_t index : pair.second) {
-                    const auto &pb = teamed.first.template get< PhysBody >()[index];
-                    const auto &seeker = teamed.first.template get< Seeker >()[index];
-
-                    const auto body = pb.body;
-                    const auto seeker_at = VPC< Vec >(body->GetPosition());
-                    const auto square_range = seeker.retargetingRange * seeker.retargetingRange;
-
-                    Entity::EntityID new_id = 0;
-                    double best_value = 0.0;
-                    for (size_t i = 0; i < ids.size(); ++i) {
-                        if (teams[i].team == pair.first) {
-                            continue;
-                        }
-
-                        const auto value = values[i].value;
-                        if (value < best_value) {
-                            continue;
-                        }
-
-                        const auto at = VPC< Vec >(tbodies[i].body->GetPosition());
-                        const auto vec_to = seeker_at - at;
-                        if (vec_to.squared_length() > square_range) {
-                            continue;
-                        }
-
-                        best_value = value;
-                        new_id = ids[i];
-                    }
-
-                    if (best_value > 0.0) {
-                        teamed.first.template get< Seeker >()[index].target = new_id;
-                    }
+        const SpatialIndex &index = spatialIndex(core);
+        for (const size_t i : retargets) {
+            auto &seeker = teamed.first.template get< Seeker >()[i];
+            const auto seeker_at = teamed.first.template get< const Transform >()[i].at;
+            SpatialIndex::Filter enemies;
+            enemies.enemiesOf = teamed.first.template get< const Team >()[i].team;
+
+            Entity::EntityID new_id = 0;
+            double best_value = 0.0;
+            index.within(seeker_at, seeker.retargetingRange, enemies, [&](const SpatialIndex::Entry &entry) {
+                const auto value = core.tracker.optComponent< const TargetValue >(entry.id);
+                if (value && value->get().value > best_value) {
+                    best_value = value->get().value;
+                    new_id = entry.id;
                 }
+            });
+
+            if (best_value > 0.0) {
+                seeker.target = new_id;
             }
-        });
+        }
     });
 }
 
 LifetimeSystem::LifetimeSystem()
-    : BaseSystem("Lifetime", Entity::getConstySignature< Lifetime >()) {
+    : BaseSystem("Lifetime", Entity::Queries< Lifetimes >::access()) {
 }
 
 LifetimeSystem::~LifetimeSystem() { }
@@ -204,7 +181,7 @@ void LifetimeSystem::init(Core &core) {
 
 void LifetimeSystem::execute(Core &core, double seconds) {
     std::vector< Entity::EntityID > kill;
-    Entity::Exec< Entity::Packs< Lifetime > >::run(core.tracker,
+    Lifetimes::run(core.tracker,
     [&](auto &data) {
         auto &lifetimes = data.first.template get< Lifetime >();
         for (size_t i = 0; i < lifetimes.size(); ++i) {
@@ -220,12 +197,7 @@ void LifetimeSystem::execute(Core &core, double seconds) {
 }
 
 TurretSystem::TurretSystem()
-    : BaseSystem("Turret", Entity::getConstySignature<
-            const Colour,
-            const PhysBody,
-            const Team,
-            Turret
-        >()) {
+    : BaseSystem("Turret", Entity::Queries< Gunners, BulletLookup, Targets >::access()) {
 }
 
 TurretSystem::~TurretSystem() { }
@@ -243,19 +215,18 @@ bool Turret::trigger() {
 Entity::EntityID standardBullet(Core &core, const BulletInfo &bi, Entity::EntityID sourceID,
                                 Point at, Vec to, std::optional< Entity::EntityID > target) {
     auto body = makeCircle(core, at, bi.radius);
-    const auto go = 1000.0 * VPC< b2Vec2 >(to);
-    body->ApplyLinearImpulse(go, body->GetPosition(), true);
     auto colour = Colour{ { 0, 0, 0 } };
     const auto source_colour = core.tracker.optComponent< const Colour >(sourceID);
     if (source_colour) {
         colour = *source_colour;
     }
 
-    const auto id = core.tracker.createWith(core,
-        PhysBody{ body },
+    const auto id = createBody(core.tracker, core,
+        body,
         colour,
         Damage{ bi.dmg },
-        Lifetime{ bi.lifetime }
+        Lifetime{ bi.lifetime },
+        Push{ Vec(0.0, 0.0), 1000.0 * to, true }
     );
 
     const auto team = core.tracker.optComponent< const Team >(sourceID);
@@ -294,94 +265,56 @@ BulletCreator getStandardBulletCreator(BulletInfo bi) {
 void runGunners(
     Core &core,
     const double seconds,
-    std::pair< Entity::Packs< const PhysBody, const Team >, const Entity::IDMap > &unarmed,
-    std::pair< Entity::Packs< const PhysBody, const Team, Turret >, const Entity::IDMap > &armed
+    const Entity::IDMap &ids,
+    Entity::ConstyContainer< const Transform >::Type &transforms,
+    Entity::ConstyContainer< const Extent >::Type &extents,
+    Entity::ConstyContainer< const Team >::Type &teams,
+    Entity::ConstyContainer< Turret >::Type &turret_groups
 ) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    auto &turret_groups = armed.first.template get< Turret >();
-    auto &armed_teams = armed.first.template get< const Team >();
-    auto &armed_bodies = armed.first.template get< const PhysBody >();
-    auto &unarmed_teams = unarmed.first.template get< const Team >();
-    auto &unarmed_bodies = unarmed.first.template get< const PhysBody >();
+    Random &gen = randomStream();
+    const SpatialIndex &index = spatialIndex(core);
     for (size_t entity_index = 0; entity_index < turret_groups.size(); ++entity_index) {
         for (auto &turret : turret_groups[entity_index]) {
             if (0.0 != turret.cooldown) {
                 turret.cooldown = std::max(0.0, turret.cooldown - seconds);
             }
             if (!turret.automatic || 0.0 != turret.cooldown) { continue; }
-            const auto team = armed_teams[entity_index].team;
-            const double range_square = turret.range * turret.range;
-            const auto body = armed_bodies[entity_index];
-            const auto source_at = VPC< Vec >(body.body->GetPosition());
-            const auto check_target =
-            [&](const PhysBody &target, const TeamNumber target_team, const Entity::EntityID tid) -> bool {
-                if (target_team == team) { return false; }
-                const auto centre = VPC< Vec >(target.body->GetPosition());
-                const Vec vec_to = centre - source_at;
-                if (vec_to.squared_length() > range_square) { return false; }
-
-                // Firing
-                turret.cooldown = turret.cooldown_length;
-                const b2Body *bd = body.body;
-                const b2Fixture *fixes = bd->GetFixtureList();
-                const b2Shape *shape = fixes->GetShape();
-                const b2CircleShape * circ = static_cast< const b2CircleShape * >(shape);
-
-                const auto offset = source_at + 1.5 * (1.0 + circ->m_radius) * normalized(vec_to);
-                const auto at = Point( offset.x(), offset.y() );
-
-                turret.bullet(core, armed.second[entity_index], at, normalized(vec_to), std::optional(tid));
-                return true;
-            };
-
-            bool shot = false;
-            if (!armed_bodies.empty()) {
-                const size_t start = std::uniform_int_distribution< size_t >(0, armed_bodies.size() - 1)(gen);
-                for (size_t j = start; j < armed_bodies.size(); ++j) {
-                    if (check_target(armed_bodies[j], armed_teams[j].team, armed.second[j])) {
-                        shot = true;
-                        break;
+            const auto source_at = transforms[entity_index].at;
+            SpatialIndex::Filter enemies;
+            enemies.enemiesOf = teams[entity_index].team;
+
+            // Picks uniformly from everything in range, one pass, no list
+            const SpatialIndex::Entry *target = nullptr;
+            const auto pick = [&](const SpatialIndex::Filter &filter) {
+                size_t seen = 0;
+                index.within(source_at, turret.range, filter, [&](const SpatialIndex::Entry &entry) {
+                    ++seen;
+                    if (0 == std::uniform_int_distribution< size_t >(0, seen - 1)(gen)) {
+                        target = &entry;
                     }
-                }
-
-                if (!shot) {
-                    for (size_t j = 0; j < start; ++j) {
-                        if (check_target(armed_bodies[j], armed_teams[j].team, armed.second[j])) {
-                            shot = true;
-                            break;
-                        }
-                    }
-                }
-            }
-
-            if (!shot && !unarmed_bodies.empty()) {
-                const size_t start = std::uniform_int_distribution< size_t >(0, unarmed_bodies.size() - 1)(gen);
-                for (size_t j = start; j < unarmed_bodies.size(); ++j) {
-                    if  (check_target(unarmed_bodies[j], unarmed_teams[j].team, unarmed.second[j])) {
-                        shot = true;
-                        break;
-                    }
-                }
-                if (!shot) {
-                    for (size_t j = 0; j < start; ++j) {
-                        if  (check_target(unarmed_bodies[j], unarmed_teams[j].team, unarmed.second[j])) {
-                            shot = true;
-                            break;
-                        }
-                    }
-                }
-            }
+                });
+            };
+            // Whatever shoots back first, anything else, like bullets, only once nothing armed is in range
+            SpatialIndex::Filter armed = enemies;
+            armed.armed = true;
+            pick(armed);
+            if (!target) { pick(enemies); }
+            if (!target) { continue; }
+
+            // Firing
+            turret.cooldown = turret.cooldown_length;
+            const Vec vec_to = target->at - source_at;
+            const auto offset = source_at + 1.5 * (1.0 + extents[entity_index].half.x()) * normalized(vec_to);
+            const auto at = Point( offset.x(), offset.y() );
+
+            turret.bullet(core, ids[entity_index], at, normalized(vec_to), std::optional(target->id));
         }
     }
 }
 
 void TurretSystem::execute(Core &core, double seconds) {
-    Entity::Exec<
-        Entity::Packs< const PhysBody, const Team >,
-        Entity::Packs< const PhysBody, const Team, Turret >
-    >::run(core.tracker,
-    [&](auto &noturrets, auto &turreters) {
-        runGunners(core, seconds, noturrets, turreters);
+    Gunners::run(core.tracker,
+    [&](const auto &ids, const auto &transforms, const auto &extents, const auto &teams, auto &turrets) {
+        runGunners(core, seconds, ids, transforms, extents, teams, turrets);
     });
 }
@@ -9,6 +9,13 @@
 #include "entities/systems.h"
 
 struct Core;
+struct Transform;
+struct Velocity;
+struct Extent;
+struct HitData;
+struct Push;
+struct Colour;
+class SpatialIndex;
 
 b2Body *makeBall(Core &core, Point centre, double rad);
 b2Body *randomBall(Core &core, double rad);
@@ -58,6 +65,8 @@ struct BulletInfo {
     bool seeking;
 };
 BulletCreator getStandardBulletCreator(BulletInfo bi);
+// What standard bullets look up on whatever fired them, for the systems that fire them
+using BulletLookup = Entity::Lookup< const Colour, const Team >;
 
 
 struct Seeker {
@@ -73,6 +82,11 @@ struct TargetValue {
 DeclareDataType(TargetValue);
 
 class DamageSystem: public Entity::BaseSystem {
+    // Things that can be hurt, split by whether they have a team to be spared by
+    using Victims = Entity::Exec< Entity::Packs< const HitData, Health >, Entity::Packs< const HitData, Health, const Team > >;
+    // Whatever hit them
+    using Hitters = Entity::Lookup< const Damage, const Team >;
+
     public:
     DamageSystem();
     ~DamageSystem();
@@ -81,6 +95,11 @@ class DamageSystem: public Entity::BaseSystem {
 };
 
 class SeekerSystem: public Entity::BaseSystem {
+    using Seekers = Entity::Exec< Entity::Packs< const Transform, Seeker, Push >, Entity::Packs< const Transform, Seeker, Push, const Team > >;
+    using Chased = Entity::Lookup< const Transform, const Velocity >;
+    // Lost seekers pick from what's near them
+    using Targets = Entity::Lookup< const TargetValue, const SpatialIndex >;
+
     public:
     SeekerSystem();
     ~SeekerSystem();
@@ -89,6 +108,8 @@ class SeekerSystem: public Entity::BaseSystem {
 };
 
 class LifetimeSystem: public Entity::BaseSystem {
+    using Lifetimes = Entity::Exec< Entity::Packs< Lifetime > >;
+
     public:
     LifetimeSystem();
     ~LifetimeSystem();
@@ -97,6 +118,10 @@ class LifetimeSystem: public Entity::BaseSystem {
 };
 
 class TurretSystem: public Entity::BaseSystem {
+    using Gunners = Entity::ExecSimple< const Transform, const Extent, const Team, Turret >;
+    // Anything near enough on another team is a target
+    using Targets = Entity::Lookup< const SpatialIndex >;
+
     public:
     TurretSystem();
     ~TurretSystem();
@@ -0,0 +1,162 @@
+#include "game/spatial.h"
+
+#include "game/npc.h"
+#include "game/swarm.h"
+#include "core/core.h"
+#include "physics/physics.h"
+#include "physics/geometry.h"
+#include "entities/access.h"
+#include "entities/exec.h"
+#include "utility/utility.h"
+
+#include <Box2D.h>
+
+#include <algorithm>
+#include <cmath>
+#include <bit>
+
+SpatialIndex::SpatialIndex(const double cell)
+    : cell(cell), starts(2, 0), lowX(0), lowY(0), highX(-1), highY(-1) {
+    rassert(cell > 0.0, "Spatial index cells need a size", cell);
+}
+
+int32_t SpatialIndex::cellOf(const double v) const {
+    // Halved, so a cell range's size still fits
+    constexpr double LIMIT = std::numeric_limits< int32_t >::max() / 2;
+    return int32_t(std::clamp(std::floor(v / cell), -LIMIT, LIMIT));
+}
+
+size_t SpatialIndex::bucketOf(const int32_t cx, const int32_t cy) const {
+    const uint32_t hash = (uint32_t(cx) * 73856093u) ^ (uint32_t(cy) * 19349663u);
+    // Bucket counts are powers of two
+    return hash & (starts.size() - 2);
+}
+
+bool SpatialIndex::covers(const Vec &centre, const double radius) const {
+    return cellOf(centre.x() - radius) <= lowX && cellOf(centre.x() + radius) >= highX
+        && cellOf(centre.y() - radius) <= lowY && cellOf(centre.y() + radius) >= highY;
+}
+
+void SpatialIndex::insert(const Entity::EntityID id, const Vec &at, const uint16_t team, const uint16_t tag, const bool armed) {
+    pending.push_back(Entry{ id, at, cellOf(at.x()), cellOf(at.y()), team, tag, armed });
+}
+
+void SpatialIndex::build() {
+    // About half the buckets end up empty, which keeps chains short
+    const size_t buckets = std::bit_ceil(std::max(size_t(1), 2 * pending.size()));
+    starts.assign(buckets + 1, 0);
+    lowX = lowY = std::numeric_limits< int32_t >::max();
+    highX = highY = std::numeric_limits< int32_t >::min();
+    for (const Entry &entry : pending) {
+        ++starts[bucketOf(entry.cx, entry.cy) + 1];
+        lowX = std::min(lowX, entry.cx);
+        lowY = std::min(lowY, entry.cy);
+        highX = std::max(highX, entry.cx);
+        highY = std::max(highY, entry.cy);
+    }
+    for (size_t i = 1; i < starts.size(); ++i) {
+        starts[i] += starts[i - 1];
+    }
+    cursors.assign(starts.begin(), starts.end() - 1);
+    entries.resize(pending.size());
+    for (const Entry &entry : pending) {
+        entries[cursors[bucketOf(entry.cx, entry.cy)]++] = entry;
+    }
+    pending.clear();
+}
+
+std::vector< const SpatialIndex::Entry * > SpatialIndex::nearest(const Vec &centre, const size_t k, const Filter &filter,
+                                                                  const double reach) const {
+    std::vector< const Entry * > found;
+    if (0 == k || entries.empty()) { return found; }
+    // Widens until there's enough, or there's nowhere left to look
+    for (double radius = std::min(cell, reach);; radius = std::min(2.0 * radius, reach)) {
+        const bool last = radius >= reach || covers(centre, radius);
+        found.clear();
+        within(centre, last ? reach : radius, filter, [&](const Entry &entry) {
+            found.push_back(&entry);
+        });
+        if (last || found.size() >= k) { break; }
+    }
+    const auto closer = [&](const Entry *left, const Entry *right) {
+        return (left->at - centre).squared_length() < (right->at - centre).squared_length();
+    };
+    const size_t kept = std::min(k, found.size());
+    std::partial_sort(found.begin(), found.begin() + kept, found.end(), closer);
+    found.resize(kept);
+    return found;
+}
+
+const SpatialIndex &spatialIndex(Core &core) {
+    CHECK_ACCESS_TO(Entity::getConstySignature< const SpatialIndex >(), "spatial index");
+    const auto index = core.getFlag< SpatialIndex >();
+    rassert(index, "No spatial index, SpatialIndexSystem needs adding");
+    return index->get();
+}
+
+SpatialIndexSystem::SpatialIndexSystem()
+    : BaseSystem("Spatial Index", Entity::Queries< Bodies, Armed, Index >::access()) {
+}
+
+SpatialIndexSystem::~SpatialIndexSystem() { }
+
+void SpatialIndexSystem::init(Core &core) {
+    core.tracker.addSource< TransformData >();
+    core.tracker.addSource< TeamData >();
+    core.tracker.addSource< SwarmTagData >();
+    core.tracker.addSource< TurretData >();
+    if (!core.getFlag< SpatialIndex >()) {
+        const double cell = core.options.count("index-cell")
+            ? core.options["index-cell"].as< double >()
+            : SpatialIndex::DEFAULT_CELL;
+        core.setFlag(SpatialIndex(cell));
+    }
+}
+
+bool SpatialIndexSystem::isArmed(const Entity::EntityID id) const {
+    return std::binary_search(armed.begin(), armed.end(), id);
+}
+
+void SpatialIndexSystem::execute(Core &core, double) {
+    auto &index = core.getFlag< SpatialIndex >()->get();
+    armed.clear();
+    Armed::run(core.tracker,
+    [&](const auto &ids, const auto &) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            armed.push_back(ids[i]);
+        }
+    });
+    std::sort(armed.begin(), armed.end());
+    Bodies::run(core.tracker,
+    [&](auto &bare, auto &both, auto &teamed, auto &tagged) {
+        {
+            const auto &transforms = bare.first.template get< const Transform >();
+            for (size_t i = 0; i < transforms.size(); ++i) {
+                index.insert(bare.second[i], transforms[i].at, SpatialIndex::NONE, SpatialIndex::NONE, isArmed(bare.second[i]));
+            }
+        }
+        {
+            const auto &transforms = both.first.template get< const Transform >();
+            const auto &teams = both.first.template get< const Team >();
+            const auto &tags = both.first.template get< const SwarmTag >();
+            for (size_t i = 0; i < transforms.size(); ++i) {
+                index.insert(both.second[i], transforms[i].at, teams[i].team, tags[i].tag, isArmed(both.second[i]));
+            }
+        }
+        {
+            const auto &transforms = teamed.first.template get< const Transform >();
+            const auto &teams = teamed.first.template get< const Team >();
+            for (size_t i = 0; i < transforms.size(); ++i) {
+                index.insert(teamed.second[i], transforms[i].at, teams[i].team, SpatialIndex::NONE, isArmed(teamed.second[i]));
+            }
+        }
+        {
+            const auto &transforms = tagged.first.template get< const Transform >();
+            const auto &tags = tagged.first.template get< const SwarmTag >();
+            for (size_t i = 0; i < transforms.size(); ++i) {
+                index.insert(tagged.second[i], transforms[i].at, SpatialIndex::NONE, tags[i].tag, isArmed(tagged.second[i]));
+            }
+        }
+    });
+    index.build();
+}
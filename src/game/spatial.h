@@ -0,0 +1,144 @@
+#pragma once
+
+#include "core/geometry.h"
+#include "entities/data.h"
+#include "entities/systems.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <cstdint>
+
+struct Core;
+struct Transform;
+struct Team;
+struct Turret;
+struct SwarmTag;
+
+// Entities hashed into a uniform grid of cells, for finding what's near a point
+// Rebuilt each tick by SpatialIndexSystem from the Transforms Physics writes,
+// so it's ordered after Physics when registered after it
+class SpatialIndex {
+    public:
+        // For entries without a team or tag, and filters that don't care about them
+        static constexpr uint16_t NONE = std::numeric_limits< uint16_t >::max();
+        static constexpr double DEFAULT_CELL = 8.0;
+
+        struct Entry {
+            Entity::EntityID id;
+            Vec at;
+            int32_t cx;
+            int32_t cy;
+            uint16_t team;
+            uint16_t tag;
+            // Has a turret, so it shoots back
+            bool armed;
+        };
+
+        // Which entries a query sees, anything by default
+        struct Filter {
+            // Only entries on this team
+            uint16_t team = NONE;
+            // Only entries on some other team, not teamless ones
+            uint16_t enemiesOf = NONE;
+            // Only entries with this swarm tag
+            uint16_t tag = NONE;
+            // Only armed entries
+            bool armed = false;
+
+            bool matches(const Entry &entry) const {
+                return (NONE == team || entry.team == team)
+                    && (NONE == enemiesOf || (NONE != entry.team && entry.team != enemiesOf))
+                    && (NONE == tag || entry.tag == tag)
+                    && (!armed || entry.armed);
+            }
+        };
+
+    private:
+        double cell;
+        // Entries grouped by bucket, and where each bucket starts, with one past the end last
+        // Buckets can hold several cells, entries keep theirs to tell them apart
+        std::vector< Entry > entries;
+        std::vector< uint32_t > starts;
+        // Entries waiting for build, and its scratch space
+        std::vector< Entry > pending;
+        std::vector< uint32_t > cursors;
+        // The cells anything is in
+        int32_t lowX, lowY, highX, highY;
+
+        // Clamped, so far off or infinite coordinates still land in a cell
+        int32_t cellOf(const double v) const;
+        size_t bucketOf(const int32_t cx, const int32_t cy) const;
+        // Whether a box around centre covers every occupied cell
+        bool covers(const Vec &centre, const double radius) const;
+
+    public:
+        SpatialIndex(const double cell = DEFAULT_CELL);
+
+        void insert(const Entity::EntityID id, const Vec &at, const uint16_t team, const uint16_t tag, const bool armed = false);
+        // Replaces what was there with what's been inserted since
+        void build();
+
+        size_t size() const { return entries.size(); }
+
+        // Calls f with every entry within radius of centre that the filter lets through
+        template< typename F >
+        void within(const Vec &centre, const double radius, const Filter &filter, const F &f) const {
+            if (entries.empty()) { return; }
+            const double square = radius * radius;
+            const auto visit = [&](const Entry &entry) {
+                if (filter.matches(entry) && (entry.at - centre).squared_length() <= square) {
+                    f(entry);
+                }
+            };
+            const int32_t x0 = std::max(lowX, cellOf(centre.x() - radius));
+            const int32_t x1 = std::min(highX, cellOf(centre.x() + radius));
+            const int32_t y0 = std::max(lowY, cellOf(centre.y() - radius));
+            const int32_t y1 = std::min(highY, cellOf(centre.y() + radius));
+            if (x0 > x1 || y0 > y1) { return; }
+            // Looking up more cells than there are entries costs more than checking them all
+            if (uint64_t(x1 - x0 + 1) * uint64_t(y1 - y0 + 1) >= entries.size()) {
+                for (const Entry &entry : entries) { visit(entry); }
+                return;
+            }
+            for (int32_t cy = y0; cy <= y1; ++cy) {
+                for (int32_t cx = x0; cx <= x1; ++cx) {
+                    const size_t bucket = bucketOf(cx, cy);
+                    for (uint32_t i = starts[bucket]; i < starts[bucket + 1]; ++i) {
+                        const Entry &entry = entries[i];
+                        if (entry.cx == cx && entry.cy == cy) { visit(entry); }
+                    }
+                }
+            }
+        }
+
+        // Up to k entries the filter lets through, closest first, none further than reach
+        std::vector< const Entry * > nearest(const Vec &centre, const size_t k, const Filter &filter,
+                                             const double reach = std::numeric_limits< double >::infinity()) const;
+};
+
+// The index built this tick, for systems that declare Entity::Lookup< const SpatialIndex >
+// Note: Systems registered before SpatialIndexSystem see last tick's
+const SpatialIndex &spatialIndex(Core &core);
+
+class SpatialIndexSystem: public Entity::BaseSystem {
+    // Everything with a position, split by what it can be filtered on
+    using Bodies = Entity::Exec<
+        Entity::Packs< const Transform >,
+        Entity::Packs< const Transform, const Team, const SwarmTag >,
+        Entity::Packs< const Transform, const Team >,
+        Entity::Packs< const Transform, const SwarmTag >
+    >;
+    // What's armed, gathered first and sorted so inserts can look entries up
+    using Armed = Entity::ExecSimple< const Turret >;
+    using Index = Entity::Lookup< SpatialIndex >;
+
+    std::vector< Entity::EntityID > armed;
+    bool isArmed(const Entity::EntityID id) const;
+
+    public:
+    SpatialIndexSystem();
+    ~SpatialIndexSystem();
+    void init(Core &core);
+    void execute(Core &core, double seconds);
+};
@@ -13,7 +13,7 @@
 #include "game/stress.h"
 
 GenerationSystem::GenerationSystem()
-    : BaseSystem("Generation", Entity::getConstySignature< Generation >()) { }
+    : BaseSystem("Generation", Entity::Queries< Generations >::access()) { }
 
 GenerationSystem::~GenerationSystem() { }
 
@@ -23,7 +23,7 @@ void GenerationSystem::init(Core &core) {
 
 void GenerationSystem::execute(Core &core, double seconds) {
     std::vector< size_t > growing;
-    Entity::ExecSimple< Generation >::run(core.tracker,
+    Generations::run(core.tracker,
     [&](const auto &, auto &generations) {
         for (auto &gen : generations) {
             gen.age += seconds;
@@ -33,11 +33,20 @@ void GenerationSystem::execute(Core &core, double seconds) {
         }
     });
     if (!growing.empty()) {
-        std::mt19937_64 rng;
+        Random &rng = randomStream();
         std::uniform_real_distribution< double > distro(0.5, 1.2);
-        for (const auto gen : growing) {
-            core.tracker.createWith(core, PhysBody{ randomBall(core, 10.0) }, Colour{ { 0xFF, 0, 0 } }, Lifetime{ distro(rng) }, Generation{ 0.0, gen + 1 });
+        std::vector< b2Body * > bodies;
+        for (size_t i = 0; i < growing.size(); ++i) {
+            bodies.push_back(randomBall(core, 10.0));
         }
+        core.tracker.createMany< PhysBody, Transform, Velocity, Extent, Colour, Lifetime, Generation >(core, growing.size(),
+            [&](size_t i) { return PhysBody{ bodies[i] }; },
+            [&](size_t i) { return transformOf(bodies[i]); },
+            [&](size_t i) { return velocityOf(bodies[i]); },
+            [&](size_t i) { return extentOf(bodies[i]); },
+            Colour{ { 0xFF, 0, 0 } },
+            [&](size_t) { return Lifetime{ distro(rng) }; },
+            [&](size_t i) { return Generation{ 0.0, growing[i] + 1 }; });
     }
 }
 
@@ -67,5 +76,5 @@ bool Stresser::update(Core &core) {
 }
 
 void Stresser::create(Core &core) {
-    core.tracker.createWith(core, PhysBody{ randomBall(core, 0.0) }, Colour{ { 0xFF, 0, 0 } }, Lifetime{ 1.2 }, Generation{ 0.0, 1 });
+    createBody(core.tracker, core, randomBall(core, 0.0), Colour{ { 0xFF, 0, 0 } }, Lifetime{ 1.2 }, Generation{ 0.0, 1 });
 }
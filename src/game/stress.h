@@ -9,6 +9,8 @@ struct Generation {
 DeclareDataType(Generation);
 
 class GenerationSystem: public Entity::BaseSystem {
+    using Generations = Entity::ExecSimple< Generation >;
+
 public:
     GenerationSystem();
     ~GenerationSystem();
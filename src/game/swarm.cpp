@@ -1,92 +1,43 @@
 #include "game/swarm.h"
 #include "input/controller.h"
 #include "game/npc.h"
+#include "game/boids.h"
 #include "core/core.h"
 #include "physics/physics.h"
 #include "entities/tracker.h"
 #include "entities/exec.h"
+#include "entities/access.h"
 #include "input/input.h"
 #include "visual/visuals.h"
 #include "visual/renderer.h"
 
-#include <map>
+#include <algorithm>
+#include <utility>
 
 namespace {
 
-void update(Core &core, std::vector< PhysBody > &pbs, const std::vector< SwarmTag > &tags,
-        const Entity::IDMap &, std::vector< Entity::EntityID > &) {
-    const size_t drones = tags.size();
-
-    struct SwarmInfo {
-        Vec centre { 0.0, 0.0 };
-        Vec heading { 0.0, 0.0 };
-        size_t count { 0 };
-        std::vector< size_t > indices;
-    };
-    std::map< uint16_t, SwarmInfo > swarms;
-    for (size_t i = 0; i < drones; ++i) {
-        auto &info = swarms[tags[i].tag];
-        ++info.count;
-        info.centre += VPC< Vec >(pbs[i].body->GetPosition());
-        info.heading += normalized(VPC< Vec >(pbs[i].body->GetLinearVelocity()));
-        info.indices.push_back(i);
-    }
-
-    for (auto &pair : swarms) {
-        pair.second.centre /= pair.second.count;
-        pair.second.heading = normalized(pair.second.heading);
-    }
-
-    const Point centre(0.0, 0.0);
-    const double tether_length = (100 + 100) / 6.0;
-    const double favoid = core.options["avoid"].as< double >();
-    const double falign = core.options["align"].as< double >();
-    const double fgroup = core.options["group"].as< double >();
-    double shy = core.options["bubble"].as< double >();
-    shy = 4.0 * shy * shy;
-    for (size_t i = 0; i < drones; ++i) {
-        const auto &info = swarms[tags[i].tag];
-        const Vec iAt = VPC< Vec >(pbs[i].body->GetPosition());
-        const Vec diff = info.centre - iAt;
-
-        Vec avoid { 0.0, 0.0 };
-        for (size_t j = 0; j < drones; ++j) {
-            if (tags[j].tag != tags[i].tag || i == j) { continue; }
-            const Vec diff = VPC< Vec >(pbs[j].body->GetPosition()) - iAt;
-            if (diff.squared_length() < shy && diff.squared_length() > 0.0) {
-                avoid -= normalized(diff) * (shy - diff.squared_length()) / shy;
-            }
-        }
-
-        const Vec centre_diff = VPC< Vec >(centre - iAt);
-        const double centre_dist = centre_diff.squared_length();
-        double centre_pull = centre_dist / tether_length;
-        if (centre_dist < tether_length * tether_length) { centre_pull = 0.0; }
-        //centre_pull *= centre_pull;
-        //centre_pull *= centre_pull;
-        Vec add = normalized(diff) * fgroup;
-        add += normalized(info.heading) * falign;
-        add += normalized(avoid) * favoid;
-        add += normalized(centre_diff) * centre_pull * 10.0;
-        pbs[i].body->ApplyForce(VPC< b2Vec2 >(add), VPC< b2Vec2 >(iAt), false);
-    }
-}
-
-void follow(Core &core, std::vector< PhysBody > &pbs, std::vector< Entity::EntityID > &) {
+void follow(Core &core, const Entity::View< const Transform > &transforms, Entity::View< Push > &pushes) {
     const double mousey = core.options["mouse"].as< double >();
     Point at = core.input.mousePos();
     at = Point(at.x() * core.renderer.getWidth(), at.y() * core.renderer.getHeight());
-    for (size_t i = 0; i < pbs.size(); ++i) {
-        const Vec iAt = VPC< Vec >(pbs[i].body->GetPosition());
-        const Vec diff = normalized(at - iAt);
-        pbs[i].body->ApplyForce(VPC< b2Vec2 >(diff * mousey),  VPC< b2Vec2 >(iAt), true);
+    for (size_t i = 0; i < transforms.size(); ++i) {
+        const Vec diff = normalized(at - transforms[i].at);
+        pushes[i].force += diff * mousey;
+        pushes[i].wake = true;
     }
 }
 
 }
 
+const SwarmStats &swarmStats(Core &core) {
+    CHECK_ACCESS_TO(Entity::getConstySignature< const SwarmStats >(), "swarm stats");
+    const auto stats = core.getFlag< SwarmStats >();
+    rassert(stats, "No swarm stats, SwarmSystem needs adding");
+    return stats->get();
+}
+
 SwarmSystem::SwarmSystem()
-    : BaseSystem("Swarm", Entity::getConstySignature< const SwarmTag, const MouseFollow, PhysBody, const HitData >()) {
+    : BaseSystem("Swarm", Entity::Queries< Drones, Followers, Stats >::access()) {
 }
 
 SwarmSystem::~SwarmSystem() { }
@@ -94,23 +45,85 @@ SwarmSystem::~SwarmSystem() { }
 void SwarmSystem::init(Core &core) {
     core.tracker.addSource< SwarmTagData >();
     core.tracker.addSource< MouseFollowData >();
+    level = Boids::parseLevel(core.options["boids"].as< std::string >());
+    if (!core.getFlag< SwarmStats >()) {
+        core.setFlag(SwarmStats{});
+    }
+}
+
+void SwarmSystem::steer(const size_t part) {
+    const size_t begin = part * step;
+    const size_t end = std::min(flock.size(), begin + step);
+    flock.forces(swarms, params, level, begin, end, fx.data(), fy.data());
+    for (size_t s = begin; s < end; ++s) {
+        // Leaves wake be, a settled drone stays asleep until something else pushes it
+        pushes[flock.added(s)]->force += Vec(fx[s], fy[s]);
+    }
 }
 
 void SwarmSystem::execute(Core &core, double) {
-    std::vector< Entity::EntityID > kill;
-    Entity::Exec< Entity::Packs< PhysBody, const SwarmTag, const HitData > >::run(core.tracker,
-    [&](auto &pack) {
-        update(core, pack.first.template get< PhysBody >(),
-                     pack.first.template get< const SwarmTag >(), pack.second, kill);
+    // Drones are gathered once into flat arrays, then split across the pool, first to sum up each swarm, then to steer
+    pushes.clear();
+    flock.clear();
+    Drones::run(core.tracker,
+    [&](const auto &, const auto &transforms, const auto &velocities, const auto &tags, const auto &, auto &steering) {
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            const Vec &at = transforms[i].at;
+            const Vec &velo = velocities[i].linear;
+            flock.add(at.x(), at.y(), velo.x(), velo.y(), tags[i].tag);
+            pushes.push_back(&steering[i]);
+        }
     });
-    Entity::ExecSimple< PhysBody, const MouseFollow >::run(core.tracker,
-    [&](const auto &, auto &pbs, auto &) {
-        follow(core, pbs, kill);
+    params = Boids::Params{
+        float(core.options["avoid"].as< double >()),
+        float(core.options["align"].as< double >()),
+        float(core.options["group"].as< double >()),
+        float(2.0 * core.options["bubble"].as< double >()),
+        float((100 + 100) / 6.0),
+    };
+
+    const size_t drones = flock.size();
+    const size_t width = std::max(size_t(1), Entity::parallelWidth(core.systems));
+    step = std::max(STEER_GRAIN, (drones + width - 1) / width);
+    const size_t parts = (drones + step - 1) / step;
+
+    // Each part sums into its own slots, added up in part order so the totals don't depend on timing
+    const size_t slots = size_t(flock.highestTag()) + 1;
+    if (partials.size() < parts) { partials.resize(parts); }
+    if (sums.size() != parts) {
+        sums.clear();
+        steers.clear();
+        for (size_t part = 0; part < parts; ++part) {
+            sums.emplace_back([this, part]() {
+                flock.sum(part * step, std::min(flock.size(), (part + 1) * step), partials[part]);
+            });
+            steers.emplace_back([this, part]() { steer(part); });
+        }
+    }
+    for (size_t part = 0; part < parts; ++part) {
+        partials[part].assign(slots, Boids::Sum{});
+    }
+    Entity::runParallel(core.systems, sums, scratch);
+    totals.assign(slots, Boids::Sum{});
+    for (size_t part = 0; part < parts; ++part) {
+        Boids::merge(partials[part], totals);
+    }
+    Boids::finish(totals, swarms);
+
+    flock.prepare(params.reach);
+    fx.resize(drones);
+    fy.resize(drones);
+    Entity::runParallel(core.systems, steers, scratch);
+    std::swap(swarms, core.getFlag< SwarmStats >()->get().swarms);
+
+    Followers::run(core.tracker,
+    [&](const auto &, const auto &transforms, const auto &, auto &steering) {
+        follow(core, transforms, steering);
     });
 }
 
 HiveTrackerSystem::HiveTrackerSystem()
-    : BaseSystem("Hive Tracker", Entity::getConstySignature< Hive, const SwarmTag >()) {
+    : BaseSystem("Hive Tracker", Entity::Queries< Stats, Hives >::access()) {
 }
 
 HiveTrackerSystem::~HiveTrackerSystem() { }
@@ -120,40 +133,39 @@ void HiveTrackerSystem::init(Core &core) {
 }
 
 void HiveTrackerSystem::execute(Core &core, double) {
-    std::map< uint16_t, size_t > tag_counts;
-    Entity::ExecSimple< const SwarmTag >::run(core.tracker,
-    [&](const auto &, const auto &tags) {
-        for (const auto &tag : tags) {
-            ++tag_counts[tag.tag];
-        }
-    });
-
-    Entity::ExecSimple< Hive >::run(core.tracker,
+    const auto &swarms = swarmStats(core).swarms;
+    Hives::run(core.tracker,
     [&](const auto &, auto &hives) {
         for (auto &hive : hives) {
-            hive.actual = tag_counts[hive.tag];
+            hive.actual = (hive.tag < swarms.size()) ? swarms[hive.tag].count : 0;
         }
     });
 }
 
-Entity::EntityID HiveSpawnerSystem::makeSwarmer(Core &core, uint16_t tag, Point3 colour) const {
-    b2Body *body = randomBall(core, 500.0);
-    return core.tracker.createWith(core,
-        PhysBody{ body },
-        Colour{ colour },
+void HiveSpawnerSystem::makeSwarmers(Core &core, const std::vector< std::pair< uint16_t, Point3 > > &spawns) const {
+    std::vector< b2Body * > bodies;
+    for (size_t i = 0; i < spawns.size(); ++i) {
+        bodies.push_back(randomBall(core, 500.0));
+    }
+    core.tracker.createMany< PhysBody, Transform, Velocity, Extent, Push, Colour, HitData, SwarmTag, Health, Team, Damage, Turret, Turret >(core, spawns.size(),
+        [&](size_t i) { return PhysBody{ bodies[i] }; },
+        [&](size_t i) { return transformOf(bodies[i]); },
+        [&](size_t i) { return velocityOf(bodies[i]); },
+        [&](size_t i) { return extentOf(bodies[i]); },
+        Push{},
+        [&](size_t i) { return Colour{ spawns[i].second }; },
         HitData{},
-        SwarmTag{ tag },
+        [&](size_t i) { return SwarmTag{ spawns[i].first }; },
         fullHealth(10.0),
-        Team{ tag },
+        [&](size_t i) { return Team{ spawns[i].first }; },
         Damage{ 0.2 },
-        Turret{ "secondary", missiler, 2.0, rnd_range(0.0, 2.0), 60.0, true },
-        Turret{ "primary", bulleter, 0.2, rnd_range(0.0, 0.2), 15.0, true }
+        [&](size_t) { return Turret{ "secondary", missiler, 2.0, rnd_range(0.0, 2.0), 60.0, true }; },
+        [&](size_t) { return Turret{ "primary", bulleter, 0.2, rnd_range(0.0, 0.2), 15.0, true }; }
     );
 }
 
 HiveSpawnerSystem::HiveSpawnerSystem()
-    : BaseSystem("Hive Spawner",
-        Entity::getConstySignature< Hive >()),
+    : BaseSystem("Hive Spawner", Entity::Queries< Hives >::access()),
         bulleter(getStandardBulletCreator(BulletInfo{
             2.0, 0.25, 0.25, 1.0, false
         })),
@@ -169,14 +181,16 @@ void HiveSpawnerSystem::init(Core &core) {
 }
 
 void HiveSpawnerSystem::execute(Core &core, double seconds) {
-    Entity::ExecSimple< Hive >::run(core.tracker,
+    std::vector< std::pair< uint16_t, Point3 > > spawns;
+    Hives::run(core.tracker,
     [&](const auto &, auto &hives) {
         for (auto &hive : hives) {
             hive.cooldown = std::max(0.0, hive.cooldown - seconds);
             if (hive.cooldown > 0.0 || hive.actual >= hive.target) { continue; }
 
-            makeSwarmer(core, hive.tag, hive.colour);
+            spawns.emplace_back(hive.tag, hive.colour);
             hive.cooldown = hive.cooldown_length;
         }
     });
+    makeSwarmers(core, spawns);
 }
@@ -4,6 +4,11 @@
 #include "entities/data.h"
 #include "entities/systems.h"
 #include "game/npc.h"
+#include "game/boids.h"
+
+#include <functional>
+#include <vector>
+
 
 struct SwarmTag {
     uint16_t tag;
@@ -12,7 +17,39 @@ DeclareDataType(SwarmTag);
 struct MouseFollow { };
 DeclareDataType(MouseFollow);
 
+// Each swarm's centre, heading and drone count as of this tick's steering, indexed by tag
+// Kept by SwarmSystem, for systems that declare Entity::Lookup< const SwarmStats >
+struct SwarmStats {
+    std::vector< Boids::Swarm > swarms;
+};
+const SwarmStats &swarmStats(Core &core);
+
 class SwarmSystem: public Entity::BaseSystem {
+    using Drones = Entity::ExecSimple< const Transform, const Velocity, const SwarmTag, const HitData, Push >;
+    using Followers = Entity::ExecSimple< const Transform, const MouseFollow, Push >;
+    using Stats = Entity::Lookup< SwarmStats >;
+    // Fewest drones worth handing to a task
+    static constexpr size_t STEER_GRAIN = 256;
+
+    // What a tick works with, kept so steady ticks don't allocate
+    Boids::Flock flock;
+    Boids::Level level = Boids::Level::Scalar;
+    Boids::Params params;
+    // Where each drone's steering goes, in the order they were added to the flock
+    std::vector< Push * > pushes;
+    // Drones each task covers, and each one's sums
+    // swarms is last tick's aggregates, swapped with SwarmStats' once this tick's are done
+    size_t step = STEER_GRAIN;
+    std::vector< std::vector< Boids::Sum > > partials;
+    std::vector< Boids::Sum > totals;
+    std::vector< Boids::Swarm > swarms;
+    std::vector< float > fx, fy;
+    // One of each a part, rebuilt only when the number of parts changes
+    std::vector< std::function< void() > > sums, steers;
+    Entity::ParallelScratch scratch;
+
+    void steer(const size_t part);
+
     public:
     SwarmSystem();
     ~SwarmSystem();
@@ -31,6 +68,9 @@ struct Hive {
 DeclareDataType(Hive);
 
 class HiveTrackerSystem: public Entity::BaseSystem {
+    using Stats = Entity::Lookup< const SwarmStats >;
+    using Hives = Entity::ExecSimple< Hive >;
+
     public:
     HiveTrackerSystem();
     ~HiveTrackerSystem();
@@ -39,6 +79,8 @@ class HiveTrackerSystem: public Entity::BaseSystem {
 };
 
 class HiveSpawnerSystem: public Entity::BaseSystem {
+    using Hives = Entity::ExecSimple< Hive >;
+
     public:
     BulletCreator bulleter;
     BulletCreator missiler;
@@ -46,5 +88,5 @@ class HiveSpawnerSystem: public Entity::BaseSystem {
     ~HiveSpawnerSystem();
     void init(Core &core);
     void execute(Core &core, double seconds);
-    Entity::EntityID makeSwarmer(Core &core, uint16_t tag, Point3 Colour) const;
+    void makeSwarmers(Core &core, const std::vector< std::pair< uint16_t, Point3 > > &spawns) const;
 };
@@ -37,27 +37,30 @@ bool mouseHeld(Core &core, const Layout &layout, const std::string &key) {
 
 // if (core.input.isHeld(SDLK_a)) {
 // SDL_BUTTON_LEFT
-void KeyboardController(Core &core, PhysBody &pb, Entity::EntityID, const Layout &layout) {
-    b2Body *body = pb.body;
-    const auto centre = body->GetPosition();
-    const double mass = body->GetMass();
+void KeyboardController(Core &core, const PhysBody &pb, Push &push, Entity::EntityID, const Layout &layout) {
+    const double mass = pb.body->GetMass();
     const double speed = 100.0 * mass;
 
+    Vec go(0.0, 0.0);
     if (keyHeld(core, layout, "up")) {
-        body->ApplyForce(b2Vec2(0.0, speed), centre, true);
+        go += Vec(0.0, speed);
     }
     if (keyHeld(core, layout, "down")) {
-        body->ApplyForce(b2Vec2(0.0, -speed), centre, true);
+        go += Vec(0.0, -speed);
     }
     if (keyHeld(core, layout, "left")) {
-        body->ApplyForce(b2Vec2(-speed, 0.0), centre, true);
+        go += Vec(-speed, 0.0);
     }
     if (keyHeld(core, layout, "rite")) {
-        body->ApplyForce(b2Vec2(speed, 0.0), centre, true);
+        go += Vec(speed, 0.0);
+    }
+    if (go.squared_length() > 0.0) {
+        push.force += go;
+        push.wake = true;
     }
 }
 
-void KeyboardTurretController(Core &core, std::vector< Turret > &turrets, Entity::EntityID eid, const Layout &layout) {
+void KeyboardTurretController(Core &core, Entity::Multi< Turret > &turrets, Entity::EntityID eid, const Layout &layout) {
     const bool fire = keyHeld(core, layout, "fire");
     const bool alt = keyHeld(core, layout, "altFire");
 
@@ -65,11 +68,11 @@ void KeyboardTurretController(Core &core, std::vector< Turret > &turrets, Entity
         return;
     }
 
-    const auto phys = core.tracker.optComponent< PhysBody >(eid);
-    if (!phys) { return; }
+    const auto transform = core.tracker.optComponent< const Transform >(eid);
+    if (!transform) { return; }
 
-    const auto centre = phys->get().body->GetPosition();
-    const auto direction = (centre.x > 0) ? Vec(-1.0, 0.0) : Vec(1.0, 0.0);
+    const auto centre = transform->get().at;
+    const auto direction = (centre.x() > 0) ? Vec(-1.0, 0.0) : Vec(1.0, 0.0);
     const auto at = VPC< Point >(centre) + direction;
 
     if (fire) {
@@ -91,7 +94,7 @@ void KeyboardTurretController(Core &core, std::vector< Turret > &turrets, Entity
     }
 }
 
-ControllerSystem::ControllerSystem(): BaseSystem("Controller", Entity::getConstySignature< PhysBody, Turret, const TurretController, const Controller, const Team >()) {
+ControllerSystem::ControllerSystem(): BaseSystem("Controller", Entity::Queries< Pilots, Gunners, Aim, BulletLookup >::access()) {
 }
 
 ControllerSystem::~ControllerSystem() { }
@@ -103,15 +106,16 @@ void ControllerSystem::init(Core &core) {
 }
 
 void ControllerSystem::execute(Core &core, double) {
-    Entity::Exec< Entity::Packs< PhysBody, const Controller > >::run(core.tracker,
+    Pilots::run(core.tracker,
     [&](auto &data) {
         auto &controllers = data.first.template get< const Controller >();
-        auto &pbs = data.first.template get< PhysBody >();
+        auto &pbs = data.first.template get< const PhysBody >();
+        auto &pushes = data.first.template get< Push >();
         for (size_t i = 0; i < pbs.size(); ++i) {
-            controllers[i].controller(core, pbs[i], data.second[i], controllers[i].layout);
+            controllers[i].controller(core, pbs[i], pushes[i], data.second[i], controllers[i].layout);
         }
     });
-    Entity::Exec< Entity::Packs< Turret, const TurretController > >::run(core.tracker,
+    Gunners::run(core.tracker,
     [&](auto &data) {
         auto &controllers = data.first.template get< const TurretController >();
         auto &pbs = data.first.template get< Turret >();
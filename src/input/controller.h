@@ -3,32 +3,40 @@
 #include "entities/data.h"
 #include "entities/tracker.h"
 #include "entities/systems.h"
+#include "game/npc.h"
 
 #include <SDL2/SDL.h>
 #include <functional>
 
 struct Core;
 struct PhysBody;
+struct Transform;
+struct Push;
 struct Turret;
 
 typedef std::map< std::string, SDL_Keycode > Layout;
 
 struct Controller {
-    std::function< void(Core &, PhysBody &, Entity::EntityID, const Layout &layout) > controller;
+    std::function< void(Core &, const PhysBody &, Push &, Entity::EntityID, const Layout &layout) > controller;
     Layout layout;
 };
 DeclareDataType(Controller);
 
 struct TurretController {
-    std::function< void(Core &, std::vector< Turret > &, Entity::EntityID, const Layout &layout) > controller;
+    std::function< void(Core &, Entity::Multi< Turret > &, Entity::EntityID, const Layout &layout) > controller;
     Layout layout;
 };
 DeclareDataType(TurretController);
 
-void KeyboardController(Core &core, PhysBody &pb, Entity::EntityID, const Layout &layout);
-void KeyboardTurretController(Core &core, std::vector< Turret > &turrets, Entity::EntityID eid, const Layout &layout);
+void KeyboardController(Core &core, const PhysBody &pb, Push &push, Entity::EntityID, const Layout &layout);
+void KeyboardTurretController(Core &core, Entity::Multi< Turret > &turrets, Entity::EntityID eid, const Layout &layout);
 
 class ControllerSystem: public Entity::BaseSystem {
+    using Pilots = Entity::Exec< Entity::Packs< const PhysBody, Push, const Controller > >;
+    using Gunners = Entity::Exec< Entity::Packs< Turret, const TurretController > >;
+    // Turret controllers aim from where the entity is, and fire standard bullets
+    using Aim = Entity::Lookup< const Transform >;
+
     public:
     ControllerSystem();
     ~ControllerSystem();
@@ -3,6 +3,7 @@
 #include <functional>
 #include <algorithm>
 #include <iostream>
+#include <optional>
 #include <iomanip>
 #include <utility>
 #include <vector>
@@ -10,8 +11,8 @@
 #include <memory>
 #include <limits>
 #include <chrono>
-#include <random>
 #include <ratio>
+#include <fstream>
 #include <coz.h>
 
 #include <valgrind/valgrind.h>
@@ -36,8 +37,10 @@
 #include "game/stress.h"
 #include "game/lines.h"
 #include "game/hall.h"
+#include "game/bench.h"
 
 #include "utility/timers.h"
+#include "utility/trace.h"
 #include "core/core.h"
 
 static const size_t WORLD_SIZE = 1000.0;
@@ -45,8 +48,35 @@ static const size_t STEPS_PER_SECOND = 60;
 
 namespace {
 
-std::mt19937_64 rng(0x88888888);
-std::uniform_real_distribution< double > distro(0.0, 1.0);
+// Points std::cout at stderr until it goes, so a report written to stdout is all that's there
+class StdoutReserved {
+    std::streambuf *original;
+    public:
+        std::ostream report;
+        StdoutReserved(): original(std::cout.rdbuf()), report(original) {
+            report.copyfmt(std::cout);
+            std::cout.rdbuf(std::cerr.rdbuf());
+        }
+        ~StdoutReserved() {
+            report.flush();
+            std::cout.rdbuf(original);
+        }
+};
+
+// One JSON object a line
+void writeLatencies(std::ostream &os, const size_t interval, const Entity::SystemManager::Latencies &latencies) {
+    os << "{\"interval\":" << interval << ",\"latency\":{";
+    for (size_t i = 0; i < latencies.size(); ++i) {
+        os << ((0 == i) ? "" : ",") << '"' << latencies[i].first << "\":";
+        writeJSON(os, latencies[i].second);
+    }
+    os << "}}" << std::endl;
+}
+
+void writeTrace(const boost::program_options::variables_map &options) {
+    const auto path = options["trace"].as< std::string >();
+    std::cout << (Trace::dump(path) ? "Wrote trace to " : "Couldn't write trace to ") << path << std::endl;
+}
 
 }
 
@@ -59,6 +89,13 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
 
     DurationTimer visuals;
     DurationTimer logic;
+    HistogramTimer logicLatency;
+    HistogramTimer visualsLatency;
+    size_t intervals = 0;
+    std::ofstream latencyLog;
+    if (core.options.count("latency")) {
+        latencyLog.open(core.options["latency"].as< std::string >(), std::ios::app);
+    }
 
     const bool sprint = core.options.count("sprint");
     const double lps = core.options["lps"].as< double >();
@@ -104,9 +141,13 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
         const auto busyStart = std::chrono::high_resolution_clock::now();
         if (logiTick.tick(duration)) {
             COZ_BEGIN("LOGIC");
+            Trace::Span span("Logic");
             ++logicCount;
             // Update input
-            inputUse.add([&](){ core.input.update(); });
+            inputUse.add([&](){
+                Trace::Span span("Input");
+                core.input.update();
+            });
 
             if (core.input.isReleased(SDLK_t)) {
                 timescale *= 0.7;
@@ -116,11 +157,17 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
                 timescale /= 0.7;
                 logiTick.setTimeScale(timescale);
             }
+            // Between ticks, so nothing's recording while it's written
+            if (core.input.isReleased(SDLK_p) && Trace::enabled()) {
+                writeTrace(core.options);
+            }
             const auto time = logicUse.add([&](){
                 core.systems.execute(core, 1.0 / lps);
+                Trace::Span span("Graduate");
                 core.tracker.graduate();
             });
             logic.tick(time);
+            logicLatency.add(time);
             ++logic_steps;
             COZ_END("LOGIC");
         }
@@ -128,6 +175,7 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
         if (drawTick.tick(duration)) {
             ++renderCount;
             const auto time = visualsUse.add([&](){
+                Trace::Span span("Render");
                 // Draw time kids!
                 if (cameraID > 0) {
                     const auto &cam = core.tracker.getComponent< Camera >(cameraID);
@@ -140,6 +188,7 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
                 core.renderer.clear();
             });
             visuals.tick(time);
+            visualsLatency.add(time);
         }
 
         if (infoTick.tick(duration)) {
@@ -147,6 +196,17 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
             const double act = actual.empty();
             const double sp = spare.empty();
             const double busy = act - sp;
+            Entity::SystemManager::Latencies latencies{
+                { "Tick", logicLatency.empty() },
+                { "Frame", visualsLatency.empty() },
+            };
+            for (auto &lat : core.systems.latencies()) {
+                latencies.push_back(std::move(lat));
+            }
+            if (latencyLog.is_open()) {
+                writeLatencies(latencyLog, intervals, latencies);
+            }
+            ++intervals;
             if (core.options.count("verbose") ||
                 (lps * timescale) - 3.0 > logicCount ||
                 fps - 3.0 > renderCount) {
@@ -164,6 +224,10 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
                 std::cout << "Systems: " << logicUse.empty();
                 std::cout << " for " << core.tracker.count() << " entites\n";
                 core.systems.dumpTimes();
+                std::cout << "Latency (ms):\n";
+                for (const auto &[name, summary] : latencies) {
+                    std::cout << '\t' << name << ": " << summary << '\n';
+                }
                 std::cout << '\n';
             }
 
@@ -189,7 +253,13 @@ static size_t mainLoop(Core &core, Game &game, AccumulateTimer &entityUse) {
 static void run(boost::program_options::variables_map &options) {
     std::unique_ptr< Renderer > renderer;
     std::unique_ptr< Input > input;
-    if (options["headless"].as< bool >()) {
+    const bool bench = options.count("bench");
+    // Thread counts, plans and scores print as systems start up and run, so they're moved off the report
+    std::optional< StdoutReserved > reserved;
+    if (bench && !options.count("bench-out")) {
+        reserved.emplace();
+    }
+    if (bench || options["headless"].as< bool >()) {
         renderer = std::make_unique< Renderer >(options["width"].as< size_t >(), options["height"].as< size_t >());
         input = std::make_unique< Input >();
     } else {
@@ -202,6 +272,13 @@ static void run(boost::program_options::variables_map &options) {
 
     input->update();
 
+    seedRandom(options["seed"].as< uint64_t >());
+
+    if (options.count("trace")) {
+        Trace::enable(options["trace-events"].as< size_t >());
+        Trace::nameThread("Main");
+    }
+
     Entity::Tracker tracker;
     AccumulateTimer entityUse;
     Entity::k_entity_timer = &entityUse;
@@ -238,8 +315,22 @@ static void run(boost::program_options::variables_map &options) {
     if (core.options.count("verbose")) {
         std::cout << "Using " << core.tracker.sourceCount() << " sources" << std::endl;
     }
+    if (bench) {
+        if (options.count("bench-out")) {
+            std::ofstream report(options["bench-out"].as< std::string >());
+            runBench(core, *game, report);
+        } else {
+            runBench(core, *game, reserved->report);
+        }
+        game->cleanup(core);
+        return;
+    }
+
     const auto steps = mainLoop(core, *game, entityUse);
     std::cout << "Ran " << steps << " logical steps." << std::endl;
+    if (Trace::enabled()) {
+        writeTrace(options);
+    }
 
     game->cleanup(core);
 }
@@ -255,6 +346,14 @@ bool getOptions(boost::program_options::variables_map &options, int argc, char *
         ("fps", po::value< double >()->default_value(STEPS_PER_SECOND), "Frames  / second")
         ("lps", po::value< double >()->default_value(STEPS_PER_SECOND), "Logic / second")
         ("j", po::value< size_t >()->default_value(0), "Thread count")
+        ("replan", po::value< size_t >()->default_value(0), "Re-plan system order from measured costs every x ticks")
+        ("seed", po::value< uint64_t >()->default_value(0x88888888), "Seed for every random stream")
+        ("bench", "Run the game headless and unpaced for --steps logic steps, then report JSON")
+        ("steps", po::value< size_t >()->default_value(1000), "Logic steps a benchmark runs for")
+        ("bench-out", po::value< std::string >(), "Write the benchmark report here instead of stdout")
+        ("trace", po::value< std::string >(), "Record a timeline, written as Chrome trace JSON to this file at exit or on P")
+        ("trace-events", po::value< size_t >()->default_value(1 << 16), "Spans kept per thread while tracing")
+        ("latency", po::value< std::string >(), "Append each second's latency percentiles to this file as JSON lines")
         ("width", po::value< size_t >()->default_value(1024), "Screen width")
         ("height", po::value< size_t >()->default_value(1024), "Screen height")
         ("verbose", "print more runtime info")
@@ -264,11 +363,13 @@ bool getOptions(boost::program_options::variables_map &options, int argc, char *
         ("runfor", po::value< double >()->default_value(infty< double >()),
                    "Run only for x seconds")
         ("c", po::value< size_t >()->default_value(1024), "Dynamic object count")
+        ("index-cell", po::value< double >()->default_value(8.0), "Cell size of the spatial index neighbour queries use")
         // Boid values
         ("avoid",  po::value< double >()->default_value(40.0), "Boid avoidance factor")
         ("align",  po::value< double >()->default_value(10.0), "Boid aligning factor")
         ("group",  po::value< double >()->default_value(10.0), "Boid grouping factor")
         ("bubble", po::value< double >()->default_value( 2.0), "Boid personal space")
+        ("boids",  po::value< std::string >()->default_value("auto"), "Boid kernel: auto, avx2, sse or scalar")
         ("mouse",  po::value< double >()->default_value( 0.0), "Boid mouse magnetism")
         ("showSeeking", "Show seeker targets")
 
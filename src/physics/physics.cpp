@@ -23,7 +23,33 @@ class PhysListener: public b2ContactListener {
 };
 std::unique_ptr< PhysListener > physListener;
 
-void update(Core &core, double seconds, std::vector< PhysBody > &, std::vector< PhysBody > &, std::vector< HitData > &hits,
+void push(Entity::View< PhysBody > &pbs, Entity::View< Push > &pushes) {
+    for (size_t i = 0; i < pushes.size(); ++i) {
+        Push &push = pushes[i];
+        b2Body *body = pbs[i].body;
+        // Untouched bodies are left be, so they can sleep
+        if (push.force.squared_length() > 0.0) {
+            body->ApplyForceToCenter(VPC< b2Vec2 >(push.force), push.wake);
+            push.force = Vec(0.0, 0.0);
+        }
+        if (push.impulse.squared_length() > 0.0) {
+            body->ApplyLinearImpulse(VPC< b2Vec2 >(push.impulse), body->GetPosition(), push.wake);
+            push.impulse = Vec(0.0, 0.0);
+        }
+        push.wake = false;
+    }
+}
+
+void mirror(const Entity::View< const PhysBody > &pbs, Entity::View< Transform > &transforms, Entity::View< Velocity > &velocities) {
+    for (size_t i = 0; i < pbs.size(); ++i) {
+        const b2Body *body = pbs[i].body;
+        transforms[i].at = VPC< Vec >(body->GetPosition());
+        transforms[i].angle = body->GetAngle();
+        velocities[i].linear = VPC< Vec >(body->GetLinearVelocity());
+    }
+}
+
+void update(Core &core, double seconds, Entity::View< PhysBody > &, Entity::View< PhysBody > &, Entity::View< HitData > &hits,
     const Entity::IDMap &, const Entity::IDMap &idmap) {
     k_collisions.clear();
     core.b2world.locked([&](){
@@ -51,6 +77,23 @@ void update(Core &core, double seconds, std::vector< PhysBody > &, std::vector<
     
 }
 
+Transform transformOf(const b2Body *body) {
+    return Transform{ VPC< Vec >(body->GetPosition()), body->GetAngle() };
+}
+
+Velocity velocityOf(const b2Body *body) {
+    return Velocity{ VPC< Vec >(body->GetLinearVelocity()) };
+}
+
+Extent extentOf(const b2Body *body) {
+    const b2Shape *shape = body->GetFixtureList()->GetShape();
+    if (b2Shape::Type::e_polygon == shape->GetType()) {
+        const b2PolygonShape *box = dynamic_cast< const b2PolygonShape * >(shape);
+        return Extent{ VPC< Vec >(box->GetVertex(2)), true };
+    }
+    return Extent{ Vec(shape->m_radius, shape->m_radius), false };
+}
+
 template<>
 void Entity::initComponent< PhysBody >(Core &, const uint64_t id, PhysBody &body) {
     rassert(body.body);
@@ -64,8 +107,17 @@ void Entity::deleteComponent< PhysBody >(Core &core, const uint64_t, PhysBody &b
     });
 }
 
+template<>
+void Entity::deleteComponents< PhysBody >(Core &core, const std::vector< uint64_t > &, const std::vector< PhysBody * > &bodies) {
+    core.b2world.locked([&](){
+        for (PhysBody *body : bodies) {
+            core.b2world.b2w->DestroyBody(body->body);
+        }
+    });
+}
+
 PhysicsSystem::PhysicsSystem()
-    : BaseSystem("Physics", Entity::getConstySignature< PhysBody, HitData >()) {
+    : BaseSystem("Physics", Entity::Queries< Bodies, Pushed, Mirrored >::access()) {
 }
 
 PhysicsSystem::~PhysicsSystem() { }
@@ -73,6 +125,10 @@ PhysicsSystem::~PhysicsSystem() { }
 void PhysicsSystem::init(Core &core) {
     core.tracker.addSource< PhysBodyData >();
     core.tracker.addSource< HitDataData >();
+    core.tracker.addSource< PushData >();
+    core.tracker.addSource< TransformData >();
+    core.tracker.addSource< VelocityData >();
+    core.tracker.addSource< ExtentData >();
 
     physListener = std::make_unique< PhysListener >();
     core.b2world.locked([&](){
@@ -81,9 +137,20 @@ void PhysicsSystem::init(Core &core) {
 }
 
 void PhysicsSystem::execute(Core &core, double seconds) {
-    Entity::Exec< Entity::Packs< PhysBody >, Entity::Packs< PhysBody, HitData > >::run(core.tracker,
+    // In table order, so it's the same every run however the steering systems were scheduled
+    Pushed::run(core.tracker,
+    [&](const auto &, auto &pbs, auto &pushes) {
+        core.b2world.locked([&](){
+            push(pbs, pushes);
+        });
+    });
+    Bodies::run(core.tracker,
     [&](auto &basics, auto &complexes) {
         update(core, seconds, basics.first.template get< PhysBody >(), complexes.first.template get< PhysBody >(),
                 complexes.first.template get< HitData >(), basics.second, complexes.second);
     });
+    Mirrored::run(core.tracker,
+    [&](const auto &, const auto &pbs, auto &transforms, auto &velocities) {
+        mirror(pbs, transforms, velocities);
+    });
 }
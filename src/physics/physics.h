@@ -16,6 +16,50 @@ template<>
 void Entity::initComponent< PhysBody >(Core &core, uint64_t id, PhysBody &body);
 template<>
 void Entity::deleteComponent< PhysBody >(Core &core, uint64_t id, PhysBody &body);
+template<>
+void Entity::deleteComponents< PhysBody >(Core &core, const std::vector< uint64_t > &ids, const std::vector< PhysBody * > &bodies);
+
+// Forces and impulses for a body's next step, which PhysicsSystem applies all at once before stepping
+// Systems add to their own entities' instead of writing to the shared body, so the scheduler sees it
+// A sleeping body only takes them if one of the systems pushing it asked for it to be woken
+struct Push {
+    Vec force{ 0.0, 0.0 };
+    Vec impulse{ 0.0, 0.0 };
+    bool wake = false;
+};
+DeclareDataType(Push);
+
+// Copies of body state in the tables, so systems that only look don't chase each body into Box2D
+// PhysicsSystem refreshes Transform and Velocity after every step
+struct Transform {
+    Vec at{ 0.0, 0.0 };
+    double angle = 0.0;
+};
+DeclareDataType(Transform);
+
+struct Velocity {
+    Vec linear{ 0.0, 0.0 };
+};
+DeclareDataType(Velocity);
+
+// How far the shape reaches from the centre, a circle's radius both ways or a box's half sizes
+// Note: Shapes don't change, so this is only set when the entity's made
+struct Extent {
+    Vec half{ 0.0, 0.0 };
+    bool box = false;
+};
+DeclareDataType(Extent);
+
+// A body's state as it is now, for entities to start out with before their first step
+Transform transformOf(const b2Body *body);
+Velocity velocityOf(const b2Body *body);
+Extent extentOf(const b2Body *body);
+
+// Makes an entity around a body, with its copies filled in
+template< typename ...Args >
+Entity::EntityID createBody(Entity::Tracker &tracker, Core &core, b2Body *body, const Args &... args) {
+    return tracker.createWith(core, PhysBody{ body }, transformOf(body), velocityOf(body), extentOf(body), args...);
+}
 
 struct HitData {
     std::vector< Entity::EntityID > id;
@@ -23,6 +67,11 @@ struct HitData {
 DeclareDataType(HitData);
 
 class PhysicsSystem: public Entity::BaseSystem {
+    // Bodies, split by whether they record what they hit
+    using Bodies = Entity::Exec< Entity::Packs< PhysBody >, Entity::Packs< PhysBody, HitData > >;
+    using Pushed = Entity::ExecSimple< PhysBody, Push >;
+    using Mirrored = Entity::ExecSimple< const PhysBody, Transform, Velocity >;
+
     public:
     PhysicsSystem();
     ~PhysicsSystem();
@@ -0,0 +1,64 @@
+#include "utility/alloc.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace Alloc {
+
+namespace {
+
+std::atomic< bool > k_counting{ false };
+std::atomic< uint64_t > k_allocations{ 0 };
+std::atomic< uint64_t > k_bytes{ 0 };
+
+}
+
+void count(const bool on) {
+    k_counting.store(on, std::memory_order_relaxed);
+}
+
+Counts counts() {
+    return Counts{ k_allocations.load(std::memory_order_relaxed), k_bytes.load(std::memory_order_relaxed) };
+}
+
+}
+
+namespace {
+
+void *allocate(const std::size_t size) noexcept {
+    if (Alloc::k_counting.load(std::memory_order_relaxed)) {
+        Alloc::k_allocations.fetch_add(1, std::memory_order_relaxed);
+        Alloc::k_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    return std::malloc(size ? size : 1);
+}
+
+}
+
+// Every unaligned form, so none of them are paired with a delete from somewhere else
+// The aligned ones are left to the standard library, which pairs them itself
+void *operator new(std::size_t size) {
+    if (void *p = allocate(size)) { return p; }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    if (void *p = allocate(size)) { return p; }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts what goes through the global operator new, for benchmarks
+// Off by default, so all it costs otherwise is a load and a branch
+namespace Alloc {
+
+struct Counts {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+void count(const bool on);
+Counts counts();
+
+}
@@ -0,0 +1,176 @@
+#include "utility/pool.h"
+#include "utility/utility.h"
+#include "utility/trace.h"
+
+namespace {
+
+// Which pool the thread works for, and its deque there
+thread_local const WorkPool *k_pool = nullptr;
+thread_local size_t k_index = 0;
+
+void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+}
+
+void WorkPool::Deque::push(const Job &job) {
+    std::lock_guard< std::mutex > lock(tex);
+    if (count == ring.size()) {
+        std::vector< Job > bigger(2 * ring.size());
+        for (size_t i = 0; i < count; ++i) {
+            bigger[i] = ring[(head + i) % ring.size()];
+        }
+        ring = std::move(bigger);
+        head = 0;
+    }
+    ring[(head + count) % ring.size()] = job;
+    ++count;
+}
+
+bool WorkPool::Deque::pop(Job &job) {
+    std::lock_guard< std::mutex > lock(tex);
+    if (0 == count) { return false; }
+    --count;
+    job = ring[(head + count) % ring.size()];
+    return true;
+}
+
+bool WorkPool::Deque::steal(Job &job) {
+    std::lock_guard< std::mutex > lock(tex);
+    if (0 == count) { return false; }
+    job = ring[head];
+    head = (head + 1) % ring.size();
+    --count;
+    return true;
+}
+
+WorkPool::WorkPool() {
+    deques.push_back(std::make_unique< Deque >());
+}
+
+WorkPool::~WorkPool() {
+    terminating = true;
+    wake();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkPool::start(const size_t count) {
+    rassert(!started(), "Pool already started");
+    // The shared deque stays last
+    for (size_t i = 0; i < count; ++i) {
+        deques.insert(deques.end() - 1, std::make_unique< Deque >());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        threads.emplace_back([this, i]() {
+            k_pool = this;
+            k_index = i;
+            Trace::nameThread("Worker " + std::to_string(i));
+            work(nullptr);
+        });
+    }
+}
+
+bool WorkPool::started() const {
+    return !threads.empty();
+}
+
+size_t WorkPool::width() const {
+    return threads.size() + 1;
+}
+
+size_t WorkPool::home() const {
+    return (this == k_pool) ? k_index : deques.size() - 1;
+}
+
+void WorkPool::queue(const Job &job) {
+    deques[home()]->push(job);
+}
+
+bool WorkPool::find(const size_t from, Job &job) {
+    if (deques[from]->pop(job)) { return true; }
+    for (size_t i = 1; i < deques.size(); ++i) {
+        if (deques[(from + i) % deques.size()]->steal(job)) { return true; }
+    }
+    return false;
+}
+
+void WorkPool::execute(const Job &job) {
+    (*job.task)();
+    // Only the end of a batch is worth waking anyone for
+    if (1 == job.remaining->fetch_sub(1)) {
+        wake();
+    }
+}
+
+void WorkPool::wake() {
+    ++epoch;
+    if (0 == sleepers) { return; }
+    // Parkers check the epoch under the lock, so passing through it means none can miss this
+    { std::lock_guard< std::mutex > lock(parkTex); }
+    parked.notify_all();
+}
+
+void WorkPool::work(const std::atomic< size_t > *remaining) {
+    const auto done = [&]() { return remaining ? 0 == *remaining : terminating.load(); };
+    const size_t me = home();
+    size_t idle = 0;
+    Job job;
+    while (!done()) {
+        if (find(me, job)) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < SPINS) {
+            relax();
+            if (0 == idle % 64) { std::this_thread::yield(); }
+            continue;
+        }
+
+        // Announce the park before the last look, so a wake after it can't be missed
+        ++sleepers;
+        const uint64_t seen = epoch;
+        if (find(me, job)) {
+            --sleepers;
+            execute(job);
+        } else if (!done()) {
+            std::unique_lock< std::mutex > lock(parkTex);
+            parked.wait(lock, [&]() { return seen != epoch; });
+            --sleepers;
+        } else {
+            --sleepers;
+        }
+        idle = 0;
+    }
+}
+
+void WorkPool::run(const std::vector< std::function< void() > > &tasks) {
+    if (tasks.empty()) { return; }
+    // Before start there's nobody to hand them to
+    if (!started()) {
+        for (const auto &task : tasks) {
+            task();
+        }
+        return;
+    }
+    std::atomic< size_t > remaining{ tasks.size() };
+    for (const auto &task : tasks) {
+        queue(Job{ &task, &remaining });
+    }
+    wake();
+    work(&remaining);
+}
+
+void WorkPool::push(const std::function< void() > &task, std::atomic< size_t > &remaining) {
+    queue(Job{ &task, &remaining });
+    wake();
+}
+
+void WorkPool::wait(std::atomic< size_t > &remaining) {
+    work(&remaining);
+}
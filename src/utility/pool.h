@@ -0,0 +1,75 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+// Threads for running batches of tasks, each with its own deque the others steal from
+// Owners push and pop at the back, thieves take from the front
+// Idle threads spin for a while before parking, so back to back batches don't pay for a wakeup
+class WorkPool {
+    public:
+        // Jobs point at their task and batch, so queueing one allocates nothing
+        struct Job {
+            const std::function< void() > *task;
+            std::atomic< size_t > *remaining;
+        };
+
+    private:
+        // Ring of jobs, grown when full
+        struct Deque {
+            std::mutex tex;
+            std::vector< Job > ring{ 64 };
+            size_t head = 0;
+            size_t count = 0;
+
+            void push(const Job &job);
+            bool pop(Job &job);
+            bool steal(Job &job);
+        };
+
+        static constexpr size_t SPINS = 2048;
+
+        // One deque a worker, and a last one shared by threads outside the pool
+        std::vector< std::unique_ptr< Deque > > deques;
+        std::vector< std::thread > threads;
+        std::atomic< bool > terminating{ false };
+
+        // Bumped whenever there's new work or a batch finishes, parked threads wait for it to move
+        std::atomic< uint64_t > epoch{ 0 };
+        std::atomic< size_t > sleepers{ 0 };
+        std::mutex parkTex;
+        std::condition_variable parked;
+
+        // The deque the calling thread pushes to and pops from first
+        size_t home() const;
+        void queue(const Job &job);
+        bool find(const size_t from, Job &job);
+        void execute(const Job &job);
+        void wake();
+        // Runs jobs until the batch is done, or without one until the pool shuts down
+        // Spins a while when there are none to be had, then parks
+        void work(const std::atomic< size_t > *remaining);
+
+    public:
+        WorkPool();
+        ~WorkPool();
+
+        void start(const size_t count);
+        bool started() const;
+        // Threads that can be working on a batch, counting the caller
+        size_t width() const;
+        // Runs the tasks and returns once they're all done, helping with any queued work meanwhile
+        // Safe to call from inside a task
+        void run(const std::vector< std::function< void() > > &tasks);
+
+        // For batches that grow as they go, like tasks that queue their dependents
+        // Note: remaining must already count the job, and the task must outlive it
+        void push(const std::function< void() > &task, std::atomic< size_t > &remaining);
+        // Works on queued jobs until remaining reaches zero
+        void wait(std::atomic< size_t > &remaining);
+};
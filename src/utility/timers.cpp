@@ -1,5 +1,9 @@
 #include "utility/timers.h"
 
+#include <algorithm>
+#include <cmath>
+#include <bit>
+
 DurationTimer::DurationTimer()
     : timingIndex(0) {
 }
@@ -64,3 +68,89 @@ double AccumulateTimer::empty() {
     accum = std::chrono::duration< double >(0);
     return a;
 }
+
+HistogramTimer::HistogramTimer()
+    : counts(BUCKETS, 0)
+    , total(0)
+    , sum(0.0)
+    , longest(0.0) {
+}
+
+size_t HistogramTimer::bucket(const uint64_t nanos) {
+    if (nanos < 2 * SUB_BUCKETS) { return nanos; }
+    const size_t shift = std::bit_width(nanos) - 1 - SUB_BITS;
+    const size_t index = (shift + 1) * SUB_BUCKETS + ((nanos >> shift) - SUB_BUCKETS);
+    return std::min(index, BUCKETS - 1);
+}
+
+double HistogramTimer::bucketSeconds(const size_t bucket) {
+    if (bucket < 2 * SUB_BUCKETS) { return bucket * 1e-9; }
+    const size_t shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t low = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    // Middle of the bucket
+    return (low + (uint64_t(1) << shift) / 2) * 1e-9;
+}
+
+void HistogramTimer::add(const std::chrono::duration< double > seconds) {
+    const double nanos = std::max(0.0, seconds.count() * 1e9);
+    ++counts[bucket(static_cast< uint64_t >(std::min(nanos, 1e18)))];
+    ++total;
+    sum += seconds;
+    longest = std::max(longest, seconds);
+}
+
+std::chrono::duration< double > HistogramTimer::add(const std::function< void() > &work) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    work();
+    const std::chrono::duration< double > time = std::chrono::high_resolution_clock::now() - start;
+    add(time);
+    return time;
+}
+
+size_t HistogramTimer::count() const {
+    return total;
+}
+
+double HistogramTimer::percentile(const double p) const {
+    if (0 == total) { return 0.0; }
+    const uint64_t rank = std::max< uint64_t >(1, std::ceil(p * total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The bucket's middle can overshoot what was actually seen
+            return std::min(bucketSeconds(i), longest.count());
+        }
+    }
+    return longest.count();
+}
+
+HistogramTimer::Summary HistogramTimer::summary() const {
+    return Summary{ total, sum.count(), percentile(0.5), percentile(0.9), percentile(0.99), longest.count() };
+}
+
+HistogramTimer::Summary HistogramTimer::empty() {
+    const Summary s = summary();
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    sum = std::chrono::duration< double >(0);
+    longest = std::chrono::duration< double >(0);
+    return s;
+}
+
+std::ostream &operator<<(std::ostream &os, const HistogramTimer::Summary &summary) {
+    return os << "p50 " << summary.p50 * 1e3
+              << " p90 " << summary.p90 * 1e3
+              << " p99 " << summary.p99 * 1e3
+              << " max " << summary.max * 1e3
+              << " (" << summary.count << ")";
+}
+
+void writeJSON(std::ostream &os, const HistogramTimer::Summary &summary) {
+    os << "{\"count\":" << summary.count
+       << ",\"total\":" << summary.total
+       << ",\"p50\":" << summary.p50 * 1e3
+       << ",\"p90\":" << summary.p90 * 1e3
+       << ",\"p99\":" << summary.p99 * 1e3
+       << ",\"max\":" << summary.max * 1e3 << '}';
+}
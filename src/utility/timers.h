@@ -2,6 +2,8 @@
 
 #include <chrono>
 #include <vector>
+#include <cstdint>
+#include <ostream>
 #include <functional>
 
 // Average duration of thing, number that could be done per second
@@ -46,3 +48,50 @@ class AccumulateTimer {
         std::chrono::duration< double > add(const std::function< void() > &work);
         double empty();
 };
+
+// Use to find how durations are spread, for percentiles the averages hide
+// Log-linear buckets like an HDR histogram, each a few percent wide, from a nanosecond to minutes
+class HistogramTimer {
+    public:
+        struct Summary {
+            size_t count;
+            double total;
+            double p50;
+            double p90;
+            double p99;
+            double max;
+        };
+
+    private:
+        // Buckets for each power of two, so a bucket is at most 1/32 of its value wide
+        static constexpr size_t SUB_BITS = 5;
+        static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+        // Longer durations land in the last bucket, max still has them exactly
+        static constexpr size_t MAX_BITS = 40;
+        static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+        std::vector< uint64_t > counts;
+        size_t total;
+        std::chrono::duration< double > sum;
+        std::chrono::duration< double > longest;
+
+        static size_t bucket(const uint64_t nanos);
+        static double bucketSeconds(const size_t bucket);
+
+    public:
+        HistogramTimer();
+        void add(const std::chrono::duration< double > seconds);
+        // Times the given function and adds the duration
+        std::chrono::duration< double > add(const std::function< void() > &work);
+        size_t count() const;
+        // Seconds that p of the durations were at or under, p in [0, 1]
+        double percentile(const double p) const;
+        Summary summary() const;
+        // Summary of everything added, and starts over
+        Summary empty();
+};
+
+// Percentiles in milliseconds
+std::ostream &operator<<(std::ostream &os, const HistogramTimer::Summary &summary);
+// As a JSON object, total in seconds and percentiles in milliseconds
+void writeJSON(std::ostream &os, const HistogramTimer::Summary &summary);
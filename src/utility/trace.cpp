@@ -0,0 +1,123 @@
+#include "utility/trace.h"
+
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iomanip>
+
+namespace Trace {
+
+std::atomic< bool > k_enabled{ false };
+
+namespace {
+
+struct Event {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// One thread's spans, oldest overwritten first
+// Only its thread writes to it, dump reads whatever's been published through written
+struct Ring {
+    size_t tid;
+    std::string name;
+    std::vector< Event > events;
+    std::atomic< size_t > written{ 0 };
+};
+
+std::chrono::steady_clock::time_point k_epoch;
+size_t k_capacity = 0;
+
+// Rings outlive their threads, so spans from finished threads still get written out
+std::mutex k_rings_tex;
+std::vector< std::shared_ptr< Ring > > k_rings;
+
+thread_local std::shared_ptr< Ring > k_ring;
+
+Ring &ring() {
+    if (!k_ring) {
+        k_ring = std::make_shared< Ring >();
+        std::lock_guard< std::mutex > lock(k_rings_tex);
+        k_ring->tid = k_rings.size();
+        k_ring->name = "Thread " + std::to_string(k_ring->tid);
+        k_rings.push_back(k_ring);
+    }
+    return *k_ring;
+}
+
+void writeString(std::ostream &os, const std::string &s) {
+    os << '"';
+    for (const char c : s) {
+        if ('"' == c || '\\' == c) { os << '\\'; }
+        os << c;
+    }
+    os << '"';
+}
+
+}
+
+void enable(const size_t capacity) {
+    if (enabled() || 0 == capacity) { return; }
+    k_epoch = std::chrono::steady_clock::now();
+    k_capacity = capacity;
+    k_enabled.store(true, std::memory_order_release);
+}
+
+void nameThread(const std::string &name) {
+    Ring &r = ring();
+    std::lock_guard< std::mutex > lock(k_rings_tex);
+    r.name = name;
+}
+
+uint64_t now() {
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - k_epoch).count();
+}
+
+void record(const char *name, const uint64_t start, const uint64_t end) {
+    Ring &r = ring();
+    if (r.events.empty()) {
+        r.events.resize(k_capacity);
+    }
+    const size_t n = r.written.load(std::memory_order_relaxed);
+    r.events[n % r.events.size()] = Event{ name, start, end };
+    r.written.store(n + 1, std::memory_order_release);
+}
+
+bool dump(const std::string &path) {
+    std::ofstream out(path);
+    if (!out) { return false; }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    const auto separate = [&]() {
+        if (!first) { out << ",\n"; }
+        first = false;
+    };
+    std::lock_guard< std::mutex > lock(k_rings_tex);
+    for (const auto &r : k_rings) {
+        separate();
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << r->tid << ",\"args\":{\"name\":";
+        writeString(out, r->name);
+        out << "}}";
+        const size_t written = r->written.load(std::memory_order_acquire);
+        const size_t kept = std::min(written, r->events.size());
+        for (size_t i = written - kept; i < written; ++i) {
+            const Event &e = r->events[i % r->events.size()];
+            separate();
+            // Complete events, so a ring that's wrapped never leaves a begin without its end
+            out << "{\"ph\":\"X\",\"name\":";
+            writeString(out, e.name);
+            out << ",\"pid\":1,\"tid\":" << r->tid
+                << ",\"ts\":" << e.start / 1000.0
+                << ",\"dur\":" << (e.end - e.start) / 1000.0 << '}';
+        }
+    }
+    out << "\n]}\n";
+    return static_cast< bool >(out);
+}
+
+}
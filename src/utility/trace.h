@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Timeline of what each thread ran and when, written out as Chrome trace event JSON
+//      for chrome://tracing or ui.perfetto.dev
+// Each thread records into its own ring, so recording takes no locks
+// While off a span costs a load and a branch, so it can stay compiled in
+namespace Trace {
+
+extern std::atomic< bool > k_enabled;
+
+inline bool enabled() {
+    return k_enabled.load(std::memory_order_acquire);
+}
+
+// Starts recording, each thread keeping its last capacity spans
+void enable(const size_t capacity);
+// Names the calling thread in the output
+void nameThread(const std::string &name);
+// Nanoseconds since recording started
+uint64_t now();
+// Note: name must outlive the trace, string literals and system names do
+void record(const char *name, const uint64_t start, const uint64_t end);
+// Writes out every thread's spans so far, returns whether it could
+// Note: Threads recording meanwhile may have their oldest spans overwritten mid-write,
+//      so it's meant for between ticks
+bool dump(const std::string &path);
+
+// Records the time from construction to destruction
+class Span {
+    const char *name;
+    uint64_t start;
+    bool on;
+
+    public:
+        Span(const char *name): name(name), start(0), on(enabled()) {
+            if (on) { start = now(); }
+        }
+        ~Span() {
+            if (on) { record(name, start, now()); }
+        }
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+};
+
+}
@@ -2,13 +2,54 @@
 
 #include <random>
 
-std::mt19937_64 rng(0x88888888);
-std::uniform_real_distribution< double > distro(0.0, 1.0);
+namespace {
+
+uint64_t k_seed = 0x88888888;
+Random k_shared(k_seed);
+thread_local RandomScope *k_random_scope = nullptr;
+
+}
+
+Random &randomStream() {
+    return k_random_scope ? k_random_scope->get() : k_shared;
+}
+
+void seedRandom(const uint64_t seed) {
+    k_seed = seed;
+    k_shared.seed(seed);
+}
+
+uint64_t randomSeed() {
+    return k_seed;
+}
+
+RandomScope::RandomScope(Random &stream)
+    : previous(k_random_scope), stream(&stream), seed(0) {
+    k_random_scope = this;
+}
+
+RandomScope::RandomScope(const uint64_t seed)
+    : previous(k_random_scope), stream(nullptr), seed(seed) {
+    k_random_scope = this;
+}
+
+RandomScope::~RandomScope() {
+    k_random_scope = previous;
+}
+
+Random &RandomScope::get() {
+    if (!stream) {
+        stream = &own.emplace(seed);
+    }
+    return *stream;
+}
 
 double rnd(const double x) {
-    return x * 2.0 * (distro(rng) - 0.5);
+    std::uniform_real_distribution< double > distro(0.0, 1.0);
+    return x * 2.0 * (distro(randomStream()) - 0.5);
 }
 
 double rnd_range(const double l, const double h) {
-    return distro(rng) * (h - l) + l;
+    std::uniform_real_distribution< double > distro(0.0, 1.0);
+    return distro(randomStream()) * (h - l) + l;
 }
@@ -4,7 +4,10 @@
 #include <algorithm>
 #include <iostream>
 #include <utility>
+#include <optional>
 #include <sstream>
+#include <random>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -32,6 +35,33 @@ T lerp(const T from, const T to, const double amount) {
     return from + (to - from) * amount;
 }
 
+typedef std::mt19937_64 Random;
+
+// Random numbers come from the calling thread's stream, or a shared one outside of any
+// Systems each get their own, so what they draw doesn't depend on which ran first
+Random &randomStream();
+// Reseeds the shared stream, and is what system streams are seeded from
+void seedRandom(const uint64_t seed);
+uint64_t randomSeed();
+
+// Makes a stream the calling thread's until the scope ends
+class RandomScope {
+    RandomScope *previous;
+    Random *stream;
+    // Streams made from a seed are only built if something draws from them
+    std::optional< Random > own;
+    uint64_t seed;
+
+    public:
+        RandomScope(Random &stream);
+        RandomScope(const uint64_t seed);
+        ~RandomScope();
+        RandomScope(const RandomScope &) = delete;
+        RandomScope &operator=(const RandomScope &) = delete;
+
+        Random &get();
+};
+
 double rnd(const double x);
 double rnd_range(const double l, const double h);
 
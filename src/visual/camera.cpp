@@ -10,7 +10,7 @@
 #include <memory>
 
 CameraSystem::CameraSystem()
-    : BaseSystem("Camera", Entity::getConstySignature< const PhysBody, const Seeker, Camera >()) {
+    : BaseSystem("Camera", Entity::Queries< Framing >::access()) {
 }
 
 CameraSystem::~CameraSystem() { }
@@ -20,15 +20,15 @@ void CameraSystem::init(Core &core) {
 }
 
 void CameraSystem::execute(Core &core, double) {
-    Entity::Exec< Entity::Packs< const PhysBody >, Entity::Packs< PhysBody, Camera > >::run(core.tracker,
+    Framing::run(core.tracker,
     [&](const auto &bodyPack, auto &cameraPack) {
-        const auto &bodies = bodyPack.first.template get< const PhysBody >();
+        const auto &transforms = bodyPack.first.template get< const Transform >();
         auto &cameraBods = cameraPack.first.template get< PhysBody >();
         auto &cameras = cameraPack.first.template get< Camera >();
         b2Vec2 botleft(infty< double >(), infty< double >());
         b2Vec2 toprite(-infty< double  >(), -infty< double >());
-        for (auto &bod : bodies) {
-            const auto pos = bod.body->GetPosition();
+        for (const auto &transform : transforms) {
+            const auto pos = VPC< b2Vec2 >(transform.at);
             botleft.x = std::min(botleft.x, pos.x);
             toprite.x = std::max(toprite.x, pos.x);
             botleft.y = std::min(botleft.y, pos.y);
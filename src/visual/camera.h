@@ -5,12 +5,18 @@
 #include "entities/data.h"
 #include "core/geometry.h"
 
+struct PhysBody;
+struct Transform;
+
 struct Camera {
     double radius;
 };
 DeclareDataType(Camera);
 
 class CameraSystem: public Entity::BaseSystem {
+    // Everything with a position, and the cameras that follow them
+    using Framing = Entity::Exec< Entity::Packs< const Transform >, Entity::Packs< PhysBody, Camera > >;
+
     public:
     CameraSystem();
     ~CameraSystem();
@@ -23,25 +23,18 @@ struct MinVis {
 
 void draw(Core &core, Entity::Tracker &tracker, Renderer &renderer, const Point position, const double scale) {
     const auto shift = VPC< b2Vec2 >(position);
-    Entity::ExecSimple< const PhysBody, const Colour >::run(tracker,
-    [&](const auto &, const auto &pbs, const auto &colours) {
+    Entity::ExecSimple< const Transform, const Extent, const Colour >::run(tracker,
+    [&](const auto &, const auto &transforms, const auto &extents, const auto &colours) {
         std::array< std::vector< MinVis >, 2 > arr;
         std::array< size_t, 2 > counts = { 0, 0 };
-        for (auto &v : arr) { v.resize(pbs.size()); }
+        for (auto &v : arr) { v.resize(transforms.size()); }
 
-        for (size_t i = 0; i < pbs.size(); ++i) {
-            b2Body *body = pbs[i].body;
-            const b2Fixture *fixes = body->GetFixtureList();
-            const b2Shape *shape = fixes->GetShape();
-            const size_t index = b2Shape::Type::e_polygon == shape->GetType();
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            const size_t index = extents[i].box;
             MinVis &mv = arr[index][counts[index]++];
-            mv.p = VPC< Point >(scale * (body->GetPosition() - shift));
-            mv.r = scale * Vec(shape->m_radius, shape->m_radius);
+            mv.p = VPC< Point >(scale * (VPC< b2Vec2 >(transforms[i].at) - shift));
+            mv.r = scale * extents[i].half;
             mv.c = colours[i].colour;
-            if (1 == index) {
-                const b2PolygonShape *box = dynamic_cast< const b2PolygonShape * >(shape);
-                mv.r = scale * VPC< Vec >(box->GetVertex(2));
-            }
         }
         for (size_t i = 0; i < counts.size(); ++i) {
             arr[i].resize(counts[i]);
@@ -59,14 +52,14 @@ void draw(Core &core, Entity::Tracker &tracker, Renderer &renderer, const Point
         flag.drawSeekerLines = !flag.drawSeekerLines;
     }
     if (flag.drawSeekerLines) {
-        Entity::ExecSimple< const PhysBody, const Colour, const Seeker >::run(tracker,
-        [&](const auto &, const auto &bodies, const auto &colours, const auto &seekers) {
-            for (size_t i = 0; i < bodies.size(); ++i) {
+        Entity::ExecSimple< const Transform, const Colour, const Seeker >::run(tracker,
+        [&](const auto &, const auto &transforms, const auto &colours, const auto &seekers) {
+            for (size_t i = 0; i < transforms.size(); ++i) {
                 const auto tid = seekers[i].target;
-                const auto optBody = tracker.optComponent< PhysBody >(tid);
-                if (!optBody) { continue; }
-                const auto src = scale * (bodies[i].body->GetPosition() - shift);
-                const auto dst = scale * (optBody->get().body->GetPosition() - shift);
+                const auto optTransform = tracker.optComponent< const Transform >(tid);
+                if (!optTransform) { continue; }
+                const auto src = scale * (VPC< b2Vec2 >(transforms[i].at) - shift);
+                const auto dst = scale * (VPC< b2Vec2 >(optTransform->get().at) - shift);
                 renderer.drawLine(VPC< Point >(src), VPC< Point >(dst), colours[i].colour);
             }
         });